@@ -4,7 +4,6 @@
 local chars = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789!@#$%^&*"
 local length = 12
 local password = ""
-local needsRender = true
 
 -- Simple PRNG using linear congruential generator
 local seed = 0
@@ -31,67 +30,42 @@ local function random_password(len)
     return table.concat(pwd)
 end
 
-function setup()
-    random_seed(app.millis())
-    password = random_password(length)
-end
-
-function loop()
-    local btn = input.button()
-    local left = input.left()
-    local up = input.up()
-    local down = input.down()
+local function render()
+    display.clear()
+    display.println("Password Gen")
+    display.println("")
+    display.println("Length: " .. length)
+    display.println("")
+    display.println("Password:")
     
-    if up then
-        length = length + 1
-        if length > 32 then length = 32 end
-        password = random_password(length)
-        needsRender = true
-        app.delay(150)
+    -- Wrap password at 21 chars
+    local pwd_line1 = string.sub(password, 1, 21)
+    display.println(pwd_line1)
+    if string.len(password) > 21 then
+        local pwd_line2 = string.sub(password, 22)
+        display.println(pwd_line2)
     end
     
-    if down then
-        length = length - 1
-        if length < 4 then length = 4 end
-        password = random_password(length)
-        needsRender = true
-        app.delay(150)
-    end
-    
-    if btn then
-        password = random_password(length)
-        needsRender = true
-        app.delay(200) -- Debounce
-    end
+    display.println("")
+    display.println("Btn:Gen U/D:Length")
     
-    if left then
-        app.exit()
-        return
-    end
+    display.refresh()
+end
+
+local function regenerate(len)
+    length = math.max(4, math.min(32, len))
+    password = random_password(length)
+    render()
+end
+
+-- No loop(): the app only runs when an input event fires
+function setup()
+    random_seed(app.millis())
     
-    if needsRender then
-        display.clear()
-        display.println("Password Gen")
-        display.println("")
-        display.println("Length: " .. length)
-        display.println("")
-        display.println("Password:")
-        
-        -- Wrap password at 21 chars
-        local pwd_line1 = string.sub(password, 1, 21)
-        display.println(pwd_line1)
-        if string.len(password) > 21 then
-            local pwd_line2 = string.sub(password, 22)
-            display.println(pwd_line2)
-        end
-        
-        display.println("")
-        display.println("Btn:Gen U/D:Length")
-        
-        display.refresh()
-        needsRender = false
-    end
+    app.on("up", function() regenerate(length + 1) end)
+    app.on("down", function() regenerate(length - 1) end)
+    app.on("button", function() regenerate(length) end)
+    app.on("left", app.exit)
     
-    app.delay(50)
+    regenerate(length)
 end
-
@@ -17,21 +17,16 @@ function setup()
             error("Cannot open /assets/tv_codes.txt")
         end
         
-        -- Read entire file as string
-        local content = file:read()
-        file:close()
-        
-        if not content or content == "" then
-            error("File is empty")
-        end
-        
-        -- Parse line by line
+        -- Parse line by line, straight from the file
         -- Format: protocol:brand:button_name:address:command:nbits
         -- Example: NEC:LG:Power:0x20DF:0x10:32
         local lineCount = 0
         local parsedCount = 0
-        for line in string.gmatch(content, "[^\r\n]+") do
-            lineCount = lineCount + 1
+        for line in file:lines() do
+            -- Blank lines do not count, so a whitespace-only file is empty
+            if string.find(line, "%S") then
+                lineCount = lineCount + 1
+            end
             -- Skip comments and empty lines
             if not string.match(line, "^%s*#") and string.len(string.gsub(line, "%s+", "")) > 0 then
                 -- Parse colon-separated format
@@ -67,6 +62,11 @@ function setup()
                 end
             end
         end
+        file:close()
+        
+        if lineCount == 0 then
+            error("File is empty")
+        end
     end)
     
     if not success then
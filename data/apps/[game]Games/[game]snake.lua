@@ -5,9 +5,16 @@
 local TILE_SIZE = 8  
 local HEADER_HEIGHT = 16  
 
-local snake = {}
+-- Cells: 0 empty, 1 snake, 2 food
+local EMPTY, SNAKE, FOOD = 0, 1, 2
+local TILE_STYLES = {"fill", "dot"}
+
+local board = nil
+-- Snake cells (y * gridW + x) from tail to head in a ring of gridW * gridH
+local body = {}
+local head = 0
+local length = 0
 local dir = {x = 1, y = 0}
-local food = {x = 0, y = 0}
 local score = 0
 local gameOver = false
 local speed = 80  
@@ -17,41 +24,29 @@ local gridW = 0
 local gridH = 0
 
 function setup()
-    math.randomseed(app.millis())
-    
-    
     gridW = math.floor(display.width() / TILE_SIZE)
     gridH = math.floor((display.height() - HEADER_HEIGHT) / TILE_SIZE)
     
     
     local startX = math.floor(gridW / 2)
     local startY = math.floor(gridH / 2)
-    snake = {{x = startX, y = startY}}
+    board = grid.new(gridW, gridH, 2)
+    head = 1
+    length = 1
+    body[head] = startY * gridW + startX
+    board:set(startX, startY, SNAKE)
     
     spawnFood()
     render()
 end
 
 function spawnFood()
-    
-    local valid = false
-    while not valid do
-        food.x = math.random(0, gridW - 1)
-        food.y = math.random(0, gridH - 1)
-        valid = true
-        for i, seg in ipairs(snake) do
-            if seg.x == food.x and seg.y == food.y then
-                valid = false
-                break
-            end
-        end
+    local x, y = board:randomFree()
+    if x then
+        board:set(x, y, FOOD)
     end
 end
 
-function gridToPixel(gx, gy)
-    return gx * TILE_SIZE, gy * TILE_SIZE + HEADER_HEIGHT
-end
-
 function render()
     display.clear()
     
@@ -63,16 +58,7 @@ function render()
         display.println("Button: exit")
     else
         display.print(0, 0, "Score: " .. tostring(score))
-        
-        
-        for i, seg in ipairs(snake) do
-            local px, py = gridToPixel(seg.x, seg.y)
-            display.fillRect(px, py, TILE_SIZE - 1, TILE_SIZE - 1)
-        end
-        
-        
-        local fx, fy = gridToPixel(food.x, food.y)
-        display.fillRect(fx + 2, fy + 2, TILE_SIZE - 5, TILE_SIZE - 5)
+        board:draw(0, HEADER_HEIGHT, TILE_SIZE, TILE_STYLES)
     end
     
     display.refresh()
@@ -102,37 +88,32 @@ function loop()
     end
     
     
-    local head = snake[1]
-    local newHead = {x = head.x + dir.x, y = head.y + dir.y}
-    
+    local cells = gridW * gridH
+    local x = body[head] % gridW + dir.x
+    local y = body[head] // gridW + dir.y
     
-    if newHead.x < 0 or newHead.x >= gridW or
-       newHead.y < 0 or newHead.y >= gridH then
+    -- nil outside the board
+    local cell = board:get(x, y)
+    if cell == nil or cell == SNAKE then
         gameOver = true
         render()
         return
     end
     
+    head = head % cells + 1
+    body[head] = y * gridW + x
+    board:set(x, y, SNAKE)
     
-    for i, seg in ipairs(snake) do
-        if newHead.x == seg.x and newHead.y == seg.y then
-            gameOver = true
-            render()
-            return
-        end
-    end
-    
-    table.insert(snake, 1, newHead)
-    
-    
-    if newHead.x == food.x and newHead.y == food.y then
+    if cell == FOOD then
+        length = length + 1
         score = score + 10
         spawnFood()
         if speed > 40 then
             speed = speed - 3
         end
     else
-        table.remove(snake)
+        local tail = body[(head - length - 1) % cells + 1]
+        board:set(tail % gridW, tail // gridW, EMPTY)
     end
     
     render()
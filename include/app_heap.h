@@ -0,0 +1,44 @@
+#ifndef APP_HEAP_H
+#define APP_HEAP_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Per-app heap accounting. malloc/calloc/realloc/free are wrapped at link
+// time (see platformio.ini); while a scope is open, every allocation made
+// by the scoped task is attributed to the running app.
+struct AppHeapStats {
+    int32_t liveBytes;
+    uint32_t peakBytes;
+    uint32_t allocCount;
+    uint32_t freeCount;
+    uint32_t largestBlock;
+    bool budgetExceeded;
+};
+
+
+void appHeapBegin(const char* appName, TaskHandle_t task, uint32_t budget = 0);
+
+
+void appHeapSetBudget(uint32_t budget);
+
+
+// For blocks an allocator takes with heap_caps_malloc on the app's behalf
+// (cpp_app_arena chunks): counted against the app whichever task calls
+void appHeapCharge(void* ptr);
+void appHeapRelease(void* ptr);
+
+
+bool appHeapActive();
+
+
+bool appHeapBudgetExceeded();
+
+
+AppHeapStats appHeapStats();
+
+
+AppHeapStats appHeapEnd();
+
+#endif 
@@ -33,7 +33,7 @@
         #define EPAPER_USE_FULL_UPDATE 1
     #endif
 
-    // ! ===== RENDER_QUEUE_SETTLE_MS (delay in milliseconds for render queue to settle before refresh) (when EPAPER with partial updates) =====
+    // ! ===== RENDER_QUEUE_SETTLE_MS (delay in milliseconds the compositor waits for more requests before a refresh) (when EPAPER with partial updates) =====
     #ifndef RENDER_QUEUE_SETTLE_MS
         #define RENDER_QUEUE_SETTLE_MS 200
     #endif
@@ -48,4 +48,99 @@
         #define JOYSTICK_INVERT_Y 0
     #endif
 
+    // ! ===== CPP_APP_STACK_SIZE (default stack size in bytes for the task each C++ app runs in) =====
+    #ifndef CPP_APP_STACK_SIZE
+        #define CPP_APP_STACK_SIZE 8192
+    #endif
+
+    // ! ===== CPP_APP_FORCE_EXIT_HOLD_MS (holding the joystick button this long asks the running C++ app to exit) =====
+    #ifndef CPP_APP_FORCE_EXIT_HOLD_MS
+        #define CPP_APP_FORCE_EXIT_HOLD_MS 3000
+    #endif
+
+    // ! ===== CPP_APP_EXIT_GRACE_MS (time a C++ app gets to honour shouldExit() before its task is force-stopped) =====
+    #ifndef CPP_APP_EXIT_GRACE_MS
+        #define CPP_APP_EXIT_GRACE_MS 1500
+    #endif
+
+    // ! ===== CPP_APP_HEAP_BUDGET (default per-app heap budget in bytes for C++ apps, 0 = unlimited) =====
+    #ifndef CPP_APP_HEAP_BUDGET
+        #define CPP_APP_HEAP_BUDGET 0
+    #endif
+
+    // ! ===== LUA_APP_HEAP_BUDGET (default heap budget in bytes for Lua apps, 0 = unlimited; scripts may override with app.heapBudget()) =====
+    #ifndef LUA_APP_HEAP_BUDGET
+        #define LUA_APP_HEAP_BUDGET 0
+    #endif
+
+    // ! ===== CPP_APP_ARENA_CHUNK_SIZE (bytes the C++ app arena reserves at a time; larger requests get their own chunk) =====
+    #ifndef CPP_APP_ARENA_CHUNK_SIZE
+        #define CPP_APP_ARENA_CHUNK_SIZE 4096
+    #endif
+
+    // ! ===== CPP_APP_ARENA_MAX_SCOPES (CppApp::ArenaScope levels that may be open inside a C++ app's arena at once) =====
+    #ifndef CPP_APP_ARENA_MAX_SCOPES
+        #define CPP_APP_ARENA_MAX_SCOPES 2
+    #endif
+
+    // ! ===== LUA_BYTECODE_CACHE (cache compiled Lua apps as <script>.luac on LittleFS and load them in binary mode) =====
+    #ifndef LUA_BYTECODE_CACHE
+        #define LUA_BYTECODE_CACHE 1
+    #endif
+
+    // ! ===== LUA_HEAP_ARENA_SIZE (bytes of the first region of each Lua app's private VM heap, 0 = no arena) =====
+    #ifndef LUA_HEAP_ARENA_SIZE
+        #define LUA_HEAP_ARENA_SIZE 32768
+    #endif
+
+    // ! ===== LUA_HEAP_ARENA_GROW_SIZE (min bytes of each region added when the Lua arena is full) =====
+    #ifndef LUA_HEAP_ARENA_GROW_SIZE
+        #define LUA_HEAP_ARENA_GROW_SIZE 16384
+    #endif
+
+    // ! ===== LUA_HEAP_ARENA_MAX_REGIONS (regions the Lua arena may grow to before allocations spill to the general heap) =====
+    #ifndef LUA_HEAP_ARENA_MAX_REGIONS
+        #define LUA_HEAP_ARENA_MAX_REGIONS 6
+    #endif
+
+    // ! ===== LUA_HEAP_CAP (max live bytes a Lua app's VM may hold before allocations raise a Lua memory error, 0 = unlimited) =====
+    #ifndef LUA_HEAP_CAP
+        #define LUA_HEAP_CAP 0
+    #endif
+
+    // ! ===== LUA_GC_IDLE_BUDGET_US (max time per frame spent on incremental Lua GC steps while the app is idle in app.delay() or between frames) =====
+    #ifndef LUA_GC_IDLE_BUDGET_US
+        #define LUA_GC_IDLE_BUDGET_US 2000
+    #endif
+
+    // ! ===== LUA_WARM_VM (keep the Lua VM, reset to a pristine snapshot, between Lua app launches; released when a C++ app starts) =====
+    #ifndef LUA_WARM_VM
+        #define LUA_WARM_VM 1
+    #endif
+
+    // ! ===== LUA_EVENT_POLL_MS (how often the controls are polled for app.on() handlers while a Lua app without loop() sleeps) =====
+    #ifndef LUA_EVENT_POLL_MS
+        #define LUA_EVENT_POLL_MS 20
+    #endif
+
+    // ! ===== LUA_PROFILER (hold right while launching a Lua app to profile that run into /storage/profiles) =====
+    #ifndef LUA_PROFILER
+        #define LUA_PROFILER 1
+    #endif
+
+    // ! ===== LUA_PROFILER_PERIOD_US (profiler sample period; each sample is charged to the running Lua stack) =====
+    #ifndef LUA_PROFILER_PERIOD_US
+        #define LUA_PROFILER_PERIOD_US 1000
+    #endif
+
+    // ! ===== SERIAL_SYNC (accept file uploads from tools/sync_fs.py over USB serial while the menu is shown) =====
+    #ifndef SERIAL_SYNC
+        #define SERIAL_SYNC 1
+    #endif
+
+    // ! ===== ENABLE_BENCH_APPS (register the allocator/runtime benchmark apps under /Applications/Bench) =====
+    #ifndef ENABLE_BENCH_APPS
+        #define ENABLE_BENCH_APPS 0
+    #endif
+
 #endif
@@ -49,6 +49,10 @@ bool isButtonReleased();
 bool isButtonHeld();
 
 
+// Reads the stick directly, without waiting for updateControls()
+bool isRightHeld();
+
+
 void waitForButtonRelease();
 
 
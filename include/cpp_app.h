@@ -3,6 +3,8 @@
 
 #include <Arduino.h>
 #include "app_runner.h"
+#include "config.h"
+#include "cpp_app_arena.h"
 #include <FlipperDisplay.h>
 #include <vector>
 #include <functional>
@@ -14,6 +16,9 @@
 
 
 
+typedef void (*CppAppCleanup)();
+
+
 namespace CppApp {
     
     void clear();
@@ -43,6 +48,13 @@ namespace CppApp {
     bool shouldExit();  
     
     
+    // Runs from the launcher once the app's task has returned, or has
+    // been force-stopped for ignoring shouldExit(), so a hook may free
+    // objects the app was using. Use it to release radios, servers and
+    // other global resources.
+    bool onExit(CppAppCleanup hook);
+    
+    
     void waitFrame(int ms);  
     
     
@@ -59,20 +71,36 @@ namespace CppApp {
 typedef void (*CppAppMain)();
 
 
-struct CppAppInfo {
-    std::string name;        
-    std::string uiPath;      
+// Registry entries live in flash: REGISTER_CPP_APP emits one constexpr
+// descriptor into the .cpp_app_registry.* input sections, which
+// cpp_app_registry.ld gathers between _cpp_app_registry_start/_end.
+struct CppAppDescriptor {
+    const char* name;
+    const char* uiPath;
+    const char* icon;
     CppAppMain mainFunc;
+    uint32_t pathHash;
+    uint32_t stackSize;
+    uint32_t heapBudget;
 };
 
 
-void registerCppApp(const char* name, const char* uiPath, CppAppMain mainFunc);
+constexpr uint32_t cppAppPathHash(const char* path, uint32_t hash = 2166136261u) {
+    return *path ? cppAppPathHash(path + 1, (hash ^ (uint8_t)*path) * 16777619u) : hash;
+}
+
 
+const CppAppDescriptor* getCppApp(const char* name);
 
-CppAppInfo* getCppApp(const char* name);
 
+const CppAppDescriptor* getCppAppByPath(const char* uiPath);
 
-std::vector<CppAppInfo>& getCppApps();
+
+const CppAppDescriptor* cppAppsBegin();
+const CppAppDescriptor* cppAppsEnd();
+
+
+size_t getCppAppCount();
 
 
 AppState runCppApp(const char* name);
@@ -103,14 +131,16 @@ void initCppApps();
 #define CPP_APP(name) void cppapp_##name()
 
 
-#define REGISTER_CPP_APP(name, uiPath) \
-    static const char* _cppAppPath_##name __attribute__((used)) = uiPath
+// heapBudget is in bytes (0 = unlimited). An app that goes over it is
+// asked to exit through shouldExit() like a long-press exit.
+#define REGISTER_CPP_APP_EX(name, uiPath, iconId, stack, heapBudget) \
+    static constexpr CppAppDescriptor _cppAppDesc_##name \
+        __attribute__((used, aligned(4), section(".cpp_app_registry." #name))) = \
+        { #name, uiPath, iconId, cppapp_##name, cppAppPathHash(uiPath), stack, heapBudget }
 
 
-void registerDemoApps();
-void registerWifiApps();
-void registerIRApps();
-void registerBLEApps();
+#define REGISTER_CPP_APP(name, uiPath) \
+    REGISTER_CPP_APP_EX(name, uiPath, "app", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET)
 
 #if __has_include("security_config.h")
     #include "security_config.h"
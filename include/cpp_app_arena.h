@@ -0,0 +1,105 @@
+#ifndef CPP_APP_ARENA_H
+#define CPP_APP_ARENA_H
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Scoped arena for C++ apps. The launcher opens it before mainFunc() runs
+// and releases every chunk in one step once the app has returned (or was
+// force-stopped), so short-lived containers never leave holes in the
+// general heap. Small blocks (<= 128 bytes) are recycled through
+// size-class free lists; anything larger is bump-allocated and only
+// handed back when it is the most recent allocation.
+//
+// The arena belongs to the app task. Never keep arena-backed containers in
+// statics or globals that outlive the app. Chunks are charged to the app's
+// heap accounting (app_heap.h), so they count towards its budget.
+namespace CppApp {
+    struct ArenaStats {
+        uint32_t reservedBytes;
+        uint32_t usedBytes;
+        uint32_t peakUsedBytes;
+        uint32_t chunkCount;
+        uint32_t allocCount;
+        uint32_t pooledReuses;
+        uint32_t fallbackAllocs;
+    };
+
+
+    void* arenaAlloc(size_t bytes);
+    void arenaFree(void* ptr, size_t bytes);
+    bool arenaActive();
+    ArenaStats arenaStats();
+
+
+    // Nested arena for the lifetime of the object: allocations made
+    // meanwhile come from it and are all released when it goes out of
+    // scope. Blocks of the enclosing arena stay valid and may still be
+    // freed inside it. Containers using it must not outlive it. Past
+    // CPP_APP_ARENA_MAX_SCOPES levels the enclosing arena is used instead.
+    class ArenaScope {
+    public:
+        ArenaScope();
+        ~ArenaScope();
+
+    private:
+        ArenaScope(const ArenaScope&) = delete;
+        ArenaScope& operator=(const ArenaScope&) = delete;
+
+        int level;
+    };
+
+
+    // Falls back to the general heap when no arena is open, so helpers
+    // taking Arena* containers still work outside a C++ app.
+    template <typename T>
+    struct ArenaAllocator {
+        typedef T value_type;
+        typedef T* pointer;
+        typedef const T* const_pointer;
+        typedef T& reference;
+        typedef const T& const_reference;
+        typedef size_t size_type;
+        typedef ptrdiff_t difference_type;
+
+        template <typename U>
+        struct rebind {
+            typedef ArenaAllocator<U> other;
+        };
+
+        ArenaAllocator() {}
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U>&) {}
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(arenaAlloc(n * sizeof(T)));
+        }
+
+        void deallocate(T* ptr, size_t n) {
+            arenaFree(ptr, n * sizeof(T));
+        }
+    };
+
+    template <typename T, typename U>
+    inline bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) { return true; }
+
+    template <typename T, typename U>
+    inline bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) { return false; }
+
+
+    template <typename T>
+    using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+    typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+}
+
+
+// Launcher side: begin before the app runs, end after it has stopped.
+void cppArenaBegin(const char* appName);
+
+
+CppApp::ArenaStats cppArenaEnd(bool report = true);
+
+#endif
@@ -41,6 +41,9 @@ void registerDynamicFolder(const char* uiPath, const char* fsPath);
 // Scan filesystem and cache folder structure (folders and file names, not contents)
 void scanAndCacheFolderStructure();
 
+// Drops the scanned entries and scans again, after files changed on flash
+void rescanDynamicFolders();
+
 // Returns entries by value now, as they might be generated dynamically
 std::vector<FSEntry> getEntriesInDir(const std::string& dirPath);
 
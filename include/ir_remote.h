@@ -63,6 +63,10 @@ void sendIRPulse(uint16_t onTime, uint16_t offTime, uint32_t frequency = 38000);
 bool initIRReceiver();
 bool scanIRCode(uint32_t timeoutMs, TVCode* outCode, char* protocolName, size_t protocolNameLen);
 
+// Non-blocking form of scanIRCode: begin once, then poll until it returns true
+void beginIRScan();
+bool pollIRCode(TVCode* outCode, char* protocolName, size_t protocolNameLen);
+
 // Custom code management
 bool saveCustomCode(const char* folderName, const char* buttonName, const TVCode* code);
 bool createCustomFolder(const char* folderName);
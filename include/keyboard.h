@@ -6,5 +6,11 @@
 
 bool showKeyboard(const char* title, char* buffer, size_t maxLen);
 
+
+// Non-blocking form: keyboardBegin() once, then keyboardStep() after each
+// updateControls() until it returns true.
+void keyboardBegin(const char* title, char* buffer, size_t maxLen);
+bool keyboardStep(const char* title, char* buffer, size_t maxLen, bool* confirmed);
+
 #endif 
 
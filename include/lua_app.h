@@ -4,6 +4,10 @@
 #include <Arduino.h>
 #include "app_runner.h"
 
+extern "C" {
+#include "lua/lua.h"
+}
+
 
 void initLua();
 
@@ -17,6 +21,22 @@ void setLuaScriptFromFile(const char* path);
 AppState luaApp();
 
 
+// Closes the VM kept warm between Lua launches to give its memory back
+void releaseWarmLuaVM();
+
+
+// The display module on its own, for native benchmarks
+int luaopen_display(lua_State* L);
+
+
+// Path of the running Lua app, "" when it was not loaded from a file
+const char* luaCurrentScriptPath();
+
+
+// Profile the next Lua launch only (see LUA_PROFILER)
+void setLuaProfileNextLaunch(bool enabled);
+
+
 
 
 
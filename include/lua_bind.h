@@ -0,0 +1,119 @@
+#ifndef LUA_BIND_H
+#define LUA_BIND_H
+
+#include <Arduino.h>
+#include <type_traits>
+
+extern "C" {
+#include "lua/lua.h"
+#include "lua/lauxlib.h"
+}
+
+// Generates the lua_CFunction for a plain C++ function at compile time:
+//
+//   static bool pinRead(int pin) { return digitalRead(pin) == HIGH; }
+//   {"read", LUA_BIND(pinRead)},
+//
+// Parameter i is fetched from stack slot i with the luaL_check* call for
+// its type (bool uses lua_toboolean, like the hand-written bindings), and
+// the result is pushed by type; void pushes nothing. The function is a
+// template argument, so each wrapper calls it directly and the compiler
+// can inline it. Bindings that need the lua_State itself (tables,
+// several results, yielding) stay hand-written.
+
+
+// Optional argument: Default when the slot is none or nil. Integral and
+// bool defaults only; LuaOpt<const char*> defaults to nullptr.
+template <typename T, long Default = 0>
+struct LuaOpt {
+    T value;
+    operator T() const { return value; }
+};
+
+
+namespace LuaBind {
+    // gnu++11 has no std::index_sequence
+    template <int... I> struct Indices {};
+    template <int N, int... I> struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+    template <int... I> struct MakeIndices<0, I...> { typedef Indices<I...> type; };
+
+    template <typename T, typename Enable = void>
+    struct Arg;
+
+    template <typename T>
+    struct Arg<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+        static inline T get(lua_State* L, int i) { return (T)luaL_checkinteger(L, i); }
+        static inline void push(lua_State* L, T v) { lua_pushinteger(L, (lua_Integer)v); }
+    };
+
+    template <typename T>
+    struct Arg<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+        static inline T get(lua_State* L, int i) { return (T)luaL_checknumber(L, i); }
+        static inline void push(lua_State* L, T v) { lua_pushnumber(L, (lua_Number)v); }
+    };
+
+    template <>
+    struct Arg<bool> {
+        static inline bool get(lua_State* L, int i) { return lua_toboolean(L, i); }
+        static inline void push(lua_State* L, bool v) { lua_pushboolean(L, v); }
+    };
+
+    template <>
+    struct Arg<const char*> {
+        static inline const char* get(lua_State* L, int i) { return luaL_checkstring(L, i); }
+        static inline void push(lua_State* L, const char* v) { lua_pushstring(L, v); }
+    };
+
+    template <typename T, long Default>
+    struct Arg<LuaOpt<T, Default> > {
+        static inline LuaOpt<T, Default> get(lua_State* L, int i) {
+            LuaOpt<T, Default> opt;
+            opt.value = lua_isnoneornil(L, i) ? (T)Default : Arg<T>::get(L, i);
+            return opt;
+        }
+    };
+
+    template <long Default>
+    struct Arg<LuaOpt<const char*, Default> > {
+        static inline LuaOpt<const char*, Default> get(lua_State* L, int i) {
+            LuaOpt<const char*, Default> opt;
+            opt.value = lua_isnoneornil(L, i) ? nullptr : luaL_checkstring(L, i);
+            return opt;
+        }
+    };
+
+
+    template <typename F, F fn>
+    struct Binding;
+
+    template <typename R, typename... A, R (*fn)(A...)>
+    struct Binding<R (*)(A...), fn> {
+        template <int... I>
+        static inline int invoke(lua_State* L, Indices<I...>) {
+            Arg<R>::push(L, fn(Arg<typename std::decay<A>::type>::get(L, I + 1)...));
+            return 1;
+        }
+
+        static int call(lua_State* L) {
+            return invoke(L, typename MakeIndices<sizeof...(A)>::type());
+        }
+    };
+
+    template <typename... A, void (*fn)(A...)>
+    struct Binding<void (*)(A...), fn> {
+        template <int... I>
+        static inline int invoke(lua_State* L, Indices<I...>) {
+            fn(Arg<typename std::decay<A>::type>::get(L, I + 1)...);
+            return 0;
+        }
+
+        static int call(lua_State* L) {
+            return invoke(L, typename MakeIndices<sizeof...(A)>::type());
+        }
+    };
+}
+
+
+#define LUA_BIND(fn) (&LuaBind::Binding<decltype(&fn), &fn>::call)
+
+#endif
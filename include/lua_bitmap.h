@@ -0,0 +1,42 @@
+#ifndef LUA_BITMAP_H
+#define LUA_BITMAP_H
+
+#include <Arduino.h>
+#include <FlipperDisplay.h>
+
+// Packed 1bpp image as stored on LittleFS (tools/image_to_bitmap.py):
+// magic "B1", then little-endian u16 width, height and frame count,
+// then each frame as rows of (width + 7) / 8 bytes, MSB first.
+#define LUA_BITMAP_MAGIC_0 'B'
+#define LUA_BITMAP_MAGIC_1 '1'
+#define LUA_BITMAP_HEADER_SIZE 8
+
+struct LuaBitmap {
+    LuaBitmap* next;
+    char* path;
+    uint16_t width;
+    uint16_t height;
+    uint16_t frames;
+    uint32_t refs;
+    uint8_t* data;
+};
+
+
+// Loads a bitmap, or shares the cached copy if it is already loaded.
+// Returns nullptr and sets *error on failure.
+LuaBitmap* luaBitmapAcquire(const char* path, const char** error);
+
+
+// Drops a reference; the bitmap is freed with its last one
+void luaBitmapRelease(LuaBitmap* bitmap);
+
+
+// frame is 0-based. Set bits are drawn white and clear bits left alone,
+// or with invert the whole frame is drawn opaque with set bits black.
+void luaBitmapDraw(FlipperDisplay* display, const LuaBitmap* bitmap, int x, int y, int frame, bool invert);
+
+
+// Same for raw pixels in the frame layout above (rows of (w + 7) / 8 bytes)
+void luaBitmapBlit(FlipperDisplay* display, const uint8_t* pixels, int w, int h, int x, int y, bool invert);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef LUA_BUFFER_H
+#define LUA_BUFFER_H
+
+#include <Arduino.h>
+
+extern "C" {
+#include "lua/lua.h"
+}
+
+// Fixed-size byte storage for Lua, read and written through typed views
+// (u8, u16, u32, little-endian). The bytes live inside the userdata of
+// the buffer that created them, so they come out of the Lua heap and are
+// freed with it; a view made by buf:view() keeps that buffer alive.
+#define LUA_BUFFER_METATABLE "Buffer"
+
+struct LuaBuffer {
+    uint8_t* data;
+    uint32_t bytes;
+    uint8_t width;
+};
+
+
+// Element count of the buffer's view
+inline uint32_t luaBufferCount(const LuaBuffer* buffer) {
+    return buffer->bytes / buffer->width;
+}
+
+
+// nullptr when the value at index is not a buffer
+LuaBuffer* luaBufferTest(lua_State* L, int index);
+
+
+LuaBuffer* luaBufferCheck(lua_State* L, int index);
+
+
+int luaopen_buffer(lua_State* L);
+
+#endif
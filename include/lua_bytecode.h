@@ -0,0 +1,55 @@
+#ifndef LUA_BYTECODE_H
+#define LUA_BYTECODE_H
+
+#include <Arduino.h>
+#include <string>
+
+extern "C" {
+#include "lua/lua.h"
+}
+
+// Compiled-chunk cache for Lua apps. "<script>.luac" sits next to the
+// script and holds a LuaChunkHeader followed by lua_dump() output. A cached
+// chunk is only used while the source still has the size and hash stored
+// in its header; tools/precompile_lua.py writes the same format at build
+// time for everything under data/.
+#define LUA_CHUNK_MAGIC "LBC1"
+
+struct LuaChunkKey {
+    uint32_t sourceSize;
+    uint32_t sourceHash;
+};
+
+struct __attribute__((packed)) LuaChunkHeader {
+    char magic[4];
+    uint16_t luaVersion;
+    uint16_t flags;
+    uint32_t sourceSize;
+    uint32_t sourceHash;
+};
+
+
+// FNV-1a, chainable across chunks of the same source
+uint32_t luaSourceHash(const char* data, size_t len, uint32_t hash = 2166136261u);
+
+
+std::string luaBytecodePath(const char* scriptPath);
+
+
+// Compiles the script by streaming it from LittleFS through a lua_load
+// reader (no copy of the source is kept), or loads its cached chunk.
+// Pushes the function or an error message and returns the lua_load status.
+int luaLoadScriptFile(lua_State* L, const char* scriptPath, bool useCache, bool* fromCache);
+
+
+// Pushes the cached function and returns true if the cache matches key
+bool luaLoadCachedChunk(lua_State* L, const char* scriptPath, LuaChunkKey key);
+
+
+// Dumps the Lua function on top of the stack (left in place)
+bool luaStoreCachedChunk(lua_State* L, const char* scriptPath, LuaChunkKey key);
+
+
+void luaInvalidateCachedChunk(const char* scriptPath);
+
+#endif
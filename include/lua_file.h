@@ -0,0 +1,20 @@
+#ifndef LUA_FILE_H
+#define LUA_FILE_H
+
+#include <Arduino.h>
+
+extern "C" {
+#include "lua/lua.h"
+}
+
+// filesystem module. filesystem.open() returns a File userdata sharing
+// one metatable; it buffers reads and writes through an internal block
+// and closes itself when collected, so a forgotten close() no longer
+// leaks the handle.
+#define LUA_FILE_METATABLE "File"
+#define LUA_FILE_BUFFER_SIZE 512
+
+
+int luaopen_filesystem(lua_State* L);
+
+#endif
@@ -2,6 +2,7 @@
 #define LUA_FS_H
 
 #include <Arduino.h>
+#include <FS.h>
 #include <vector>
 #include <string>
 
@@ -24,6 +25,18 @@ bool scriptExists(const char* path);
 std::string getScriptDataFolder(const char* scriptPath);
 
 
+// <data folder>/filename, or "" when the folder is missing and create is false
+std::string getDataFilePath(const char* scriptPath, const char* filename, bool create);
+
+
+// Atomic replace: the content goes to path + ".tmp", and only a commit
+// renames it over path, so readers see the old file or the new one whole
+File beginAtomicWrite(const char* path);
+
+
+bool finishAtomicWrite(File& file, const char* path, bool commit);
+
+
 std::string readDataFile(const char* scriptPath, const char* filename);
 
 
@@ -0,0 +1,28 @@
+#ifndef LUA_GRID_H
+#define LUA_GRID_H
+
+#include <Arduino.h>
+
+extern "C" {
+#include "lua/lua.h"
+}
+
+// grid module: a w x h board of small integer cells packed 1, 2, 4 or 8
+// bits each, for games that keep occupancy or tiles per cell. Lookups,
+// region fills, picking a random free cell and drawing the board all run
+// natively, so a frame of game logic needs no per-cell Lua tables.
+// Cells are addressed from (0, 0) like display pixels.
+#define LUA_GRID_METATABLE "Grid"
+#define LUA_GRID_MAX_CELLS (64 * 1024)
+
+struct LuaGrid {
+    uint16_t width;
+    uint16_t height;
+    uint8_t bits;
+    uint8_t* cells;
+};
+
+
+int luaopen_grid(lua_State* L);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef LUA_HEAP_H
+#define LUA_HEAP_H
+
+#include <Arduino.h>
+
+extern "C" {
+#include "lua/lua.h"
+}
+
+// Private heap for the running Lua app's VM. One region of
+// LUA_HEAP_ARENA_SIZE bytes is reserved when the state is created and
+// handed to a multi_heap instance; the VM allocates only from its regions,
+// so its churn never fragments the general heap. When no region has room,
+// another of at least LUA_HEAP_ARENA_GROW_SIZE bytes is added, up to
+// LUA_HEAP_ARENA_MAX_REGIONS; only past that do allocations spill to the
+// general heap through malloc, where app_heap accounts for them. Past LUA_HEAP_CAP live bytes the allocator
+// fails, which Lua reports to the script as "not enough memory". Bytes
+// held by shared library modules (see lua_require.h) count towards
+// libraryBytes instead of the cap.
+struct LuaHeapStats {
+    uint32_t arenaBytes;
+    uint32_t liveBytes;
+    uint32_t peakBytes;
+    uint32_t cap;
+    uint32_t libraryBytes;
+    uint32_t totalFree;
+    uint32_t largestFree;
+    uint32_t fragmentationPct;
+    uint32_t regions;
+    uint32_t spilledAllocs;
+    uint32_t spilledBytes;
+    uint32_t failedAllocs;
+};
+
+
+lua_State* luaHeapNewState(const char* appName);
+
+
+// Starts per-app peak/failure counters on a state that is being reused
+void luaHeapBeginApp(const char* appName);
+
+
+LuaHeapStats luaHeapReport();
+
+
+// One line on what the last app spilled to the general heap, for the
+// app_heap leak report
+void luaHeapReportSpills();
+
+
+// lua_close()s the state, prints the report and releases the arena
+LuaHeapStats luaHeapCloseState(lua_State* L, bool report = true);
+
+
+LuaHeapStats luaHeapStats();
+
+
+// Moves bytes of the live total from the app to the loaded libraries
+void luaHeapAddLibraryBytes(uint32_t bytes);
+
+#endif
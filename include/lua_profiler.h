@@ -0,0 +1,27 @@
+#ifndef LUA_PROFILER_H
+#define LUA_PROFILER_H
+
+#include <Arduino.h>
+
+extern "C" {
+#include "lua/lua.h"
+}
+
+// Sampling profiler for one Lua app run. A periodic esp_timer ticks every
+// LUA_PROFILER_PERIOD_US; a count hook hands the ticks that passed to the
+// Lua stack that is running, and call/return hooks charge time spent in
+// native bindings (display.fillRect, gpio.write, ...) to the binding.
+// Stopping writes folded stacks to /storage/profiles/<app>.folded and
+// prints a summary on serial.
+bool luaProfilerStart(lua_State* L, const char* appName);
+
+
+// Call right before the runner enters Lua, so time spent outside Lua
+// (sleeping, drawing, waiting) is not charged to the next sample.
+void luaProfilerSync();
+
+
+// thread is the loop() coroutine, if any; it carries its own hook
+void luaProfilerStop(lua_State* L, lua_State* thread);
+
+#endif
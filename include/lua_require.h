@@ -0,0 +1,22 @@
+#ifndef LUA_REQUIRE_H
+#define LUA_REQUIRE_H
+
+#include <Arduino.h>
+
+extern "C" {
+#include "lua/lua.h"
+}
+
+// require() for Lua apps. A name resolves to a module the firmware opened
+// (string, display, ...) or to LUA_LIB_DIR/<name>.lua, with dots as
+// folder separators, loaded through the bytecode cache. Library modules
+// live in a registry table outside the warm VM's snapshot, so they stay
+// loaded from one launch to the next; their memory is counted as library
+// bytes in lua_heap rather than against the app.
+#define LUA_LIB_DIR "/apps/lib"
+
+
+// Registers the global require(); call before luaVmSnapshot()
+void luaRequireInit(lua_State* L);
+
+#endif
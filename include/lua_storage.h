@@ -0,0 +1,32 @@
+#ifndef LUA_STORAGE_H
+#define LUA_STORAGE_H
+
+#include <Arduino.h>
+
+extern "C" {
+#include "lua/lua.h"
+}
+
+// storage module: storage.save(name, value) / storage.load(name) keep Lua
+// values in <name>.dat in the running app's data folder.
+//
+// File format: magic "LSD" and a version byte, then one value. Each value
+// is a tag byte followed by its payload; integers and lengths are LEB128
+// varints (integers zigzag encoded), floats are little-endian doubles.
+// Strings up to STORAGE_SHORT_STRING bytes are numbered in the order they
+// first appear, and repeats are written as a reference to that number.
+#define STORAGE_TAG_NIL 0
+#define STORAGE_TAG_FALSE 1
+#define STORAGE_TAG_TRUE 2
+#define STORAGE_TAG_INT 3
+#define STORAGE_TAG_FLOAT 4
+#define STORAGE_TAG_STRING 5
+#define STORAGE_TAG_STRING_REF 6
+#define STORAGE_TAG_TABLE 7     // array count, hash count, array values, key/value pairs
+
+#define STORAGE_SHORT_STRING 40
+
+
+int luaopen_storage(lua_State* L);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef LUA_VM_H
+#define LUA_VM_H
+
+#include <Arduino.h>
+
+extern "C" {
+#include "lua/lua.h"
+#include "lua/lauxlib.h"
+}
+
+// Lets one Lua VM serve app after app. luaVmSnapshot() records the
+// pristine contents of _G, package.loaded, the string metatable and every
+// module table, plus the set of registry keys. luaVmReset() puts all of
+// them back, drops anything the app added to the registry (refs,
+// metatables, callbacks) and runs a full collection, so nothing an app
+// created is reachable by the next one.
+void luaVmSnapshot(lua_State* L);
+
+
+// Returns false if the state could not be verified clean; close it then.
+bool luaVmReset(lua_State* L, int keepTop);
+
+
+// Installs an __index on _G that opens each listed module (through
+// luaL_requiref) the first time a script reads its global. Whatever the
+// opener adds is folded into the snapshot, so a warm VM keeps it.
+void luaVmSetLazyModules(lua_State* L, const luaL_Reg* modules);
+
+
+// Adds a table created after the snapshot to it, so every reset puts the
+// table back the way it is now. A table the snapshot already holds keeps
+// its earlier copy. The caller keeps the table reachable.
+void luaVmAdoptTable(lua_State* L, int idx);
+
+#endif
@@ -51,4 +51,7 @@ int getVisibleItemCount();
 
 void invalidateMenu();
 
+// Re-reads the current folder after the entry tree was rebuilt
+void refreshMenuEntries();
+
 #endif 
@@ -0,0 +1,31 @@
+#ifndef SERIAL_SYNC_H
+#define SERIAL_SYNC_H
+
+#include <Arduino.h>
+
+// File sync over the USB serial port (tools/sync_fs.py), so changing one
+// script does not mean reflashing the whole LittleFS image. Commands are
+// text lines starting with "SYNC "; every reply line starts with "@SYNC "
+// so the host can skip log output in between.
+//
+//   SYNC HELLO                        -> @SYNC OK <version> <chunk size>
+//   SYNC CHECK <size> <hash> <path>   -> @SYNC SAME | @SYNC DIFF
+//   SYNC PUT <size> <hash> <path>     -> @SYNC READY, then per chunk of at
+//                                        most <chunk size> raw bytes
+//                                        @SYNC ACK <bytes so far>, then
+//                                        @SYNC DONE | @SYNC ERR <message>
+//   SYNC DEL <path>                   -> @SYNC DONE | @SYNC ERR <message>
+//   SYNC END                          -> @SYNC OK <files changed>
+//
+// <hash> is FNV-1a of the content in hex, as luaSourceHash() computes it.
+// A PUT only replaces the file once every byte arrived and the hash
+// matched. The host must wait for each ACK before sending the next chunk.
+#define SERIAL_SYNC_VERSION 1
+#define SERIAL_SYNC_CHUNK_SIZE 256
+
+
+// Call from the menu loop while no app runs. Returns true after a session
+// that changed files has ended and the menu was rebuilt.
+bool serialSyncPoll();
+
+#endif
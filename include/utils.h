@@ -66,12 +66,24 @@ void acquireDisplayLock();
 void releaseDisplayLock();
 
 
+bool isDisplayLockHeldBy(TaskHandle_t task);
 
 
 
 
 
-void initRenderQueue();
+
+
+typedef void (*CompositorSceneFunc)();
+
+
+void initCompositor();
+
+
+void setCompositorMenuScene(CompositorSceneFunc scene);
+
+
+void requestMenuRender();
 
 
 void requestDisplayRefresh();
@@ -83,6 +95,9 @@ bool isRenderBusy();
 bool isRenderPending();
 
 
+void printCompositorStats();
+
+
 int getDisplayScale();
 
 
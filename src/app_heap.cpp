@@ -0,0 +1,164 @@
+#include "app_heap.h"
+#include <esp_heap_caps.h>
+#include <string.h>
+
+extern "C" {
+    void* __real_malloc(size_t size);
+    void* __real_calloc(size_t count, size_t size);
+    void* __real_realloc(void* ptr, size_t size);
+    void __real_free(void* ptr);
+}
+
+
+static volatile bool trackingActive = false;
+static volatile TaskHandle_t trackedTask = NULL;
+static AppHeapStats stats;
+static uint32_t heapBudget = 0;
+static char trackedName[32] = "";
+static size_t largestFreeBefore = 0;
+static size_t freeHeapBefore = 0;
+
+static inline bool isTracked() {
+    return trackingActive && xTaskGetCurrentTaskHandle() == trackedTask;
+}
+
+static inline void recordAlloc(void* ptr) {
+    if (!ptr) return;
+    size_t size = heap_caps_get_allocated_size(ptr);
+    stats.allocCount++;
+    stats.liveBytes += size;
+    if (stats.liveBytes > 0 && (uint32_t)stats.liveBytes > stats.peakBytes) {
+        stats.peakBytes = stats.liveBytes;
+    }
+    if (size > stats.largestBlock) {
+        stats.largestBlock = size;
+    }
+    // Never fail the allocation itself: C++ apps cannot recover from a
+    // NULL new. The runner sees the flag and asks the app to exit.
+    if (heapBudget > 0 && stats.liveBytes > (int32_t)heapBudget) {
+        stats.budgetExceeded = true;
+    }
+}
+
+static inline void recordFree(size_t size) {
+    stats.freeCount++;
+    stats.liveBytes -= size;
+}
+
+extern "C" void* __wrap_malloc(size_t size) {
+    void* ptr = __real_malloc(size);
+    if (isTracked()) recordAlloc(ptr);
+    return ptr;
+}
+
+extern "C" void* __wrap_calloc(size_t count, size_t size) {
+    void* ptr = __real_calloc(count, size);
+    if (isTracked()) recordAlloc(ptr);
+    return ptr;
+}
+
+extern "C" void* __wrap_realloc(void* ptr, size_t size) {
+    if (!isTracked()) {
+        return __real_realloc(ptr, size);
+    }
+    
+    size_t oldSize = ptr ? heap_caps_get_allocated_size(ptr) : 0;
+    void* result = __real_realloc(ptr, size);
+    if (result || size == 0) {
+        if (ptr) recordFree(oldSize);
+        recordAlloc(result);
+    }
+    return result;
+}
+
+extern "C" void __wrap_free(void* ptr) {
+    if (ptr && isTracked()) {
+        recordFree(heap_caps_get_allocated_size(ptr));
+    }
+    __real_free(ptr);
+}
+
+
+void appHeapBegin(const char* appName, TaskHandle_t task, uint32_t budget) {
+    trackingActive = false;
+    
+    memset(&stats, 0, sizeof(stats));
+    heapBudget = budget;
+    strncpy(trackedName, appName ? appName : "", sizeof(trackedName) - 1);
+    trackedName[sizeof(trackedName) - 1] = '\0';
+    largestFreeBefore = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    freeHeapBefore = ESP.getFreeHeap();
+    
+    trackedTask = task ? task : xTaskGetCurrentTaskHandle();
+    trackingActive = true;
+}
+
+void appHeapSetBudget(uint32_t budget) {
+    heapBudget = budget;
+    if (budget > 0 && stats.liveBytes > (int32_t)budget) {
+        stats.budgetExceeded = true;
+    }
+}
+
+void appHeapCharge(void* ptr) {
+    if (ptr && trackingActive) recordAlloc(ptr);
+}
+
+void appHeapRelease(void* ptr) {
+    if (ptr && trackingActive) recordFree(heap_caps_get_allocated_size(ptr));
+}
+
+bool appHeapActive() {
+    return trackingActive;
+}
+
+bool appHeapBudgetExceeded() {
+    return trackingActive && stats.budgetExceeded;
+}
+
+AppHeapStats appHeapStats() {
+    return stats;
+}
+
+AppHeapStats appHeapEnd() {
+    if (!trackingActive) {
+        return stats;
+    }
+    trackingActive = false;
+    trackedTask = NULL;
+    
+    size_t largestFreeAfter = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    size_t freeHeapAfter = ESP.getFreeHeap();
+    
+    Serial.print(F("[HEAP] "));
+    Serial.print(trackedName);
+    Serial.print(F(": leaked "));
+    Serial.print(stats.liveBytes);
+    Serial.print(F(" bytes | Peak: "));
+    Serial.print(stats.peakBytes);
+    Serial.print(F(" | Allocs: "));
+    Serial.print(stats.allocCount);
+    Serial.print(F(" | Frees: "));
+    Serial.print(stats.freeCount);
+    Serial.print(F(" | Largest alloc: "));
+    Serial.println(stats.largestBlock);
+    
+    Serial.print(F("[HEAP] Largest free block: "));
+    Serial.print(largestFreeBefore);
+    Serial.print(F(" -> "));
+    Serial.print(largestFreeAfter);
+    Serial.print(F(" ("));
+    Serial.print((int32_t)largestFreeAfter - (int32_t)largestFreeBefore);
+    Serial.print(F(") | Free heap: "));
+    Serial.print(freeHeapBefore);
+    Serial.print(F(" -> "));
+    Serial.print(freeHeapAfter);
+    if (stats.budgetExceeded) {
+        Serial.print(F(" | budget of "));
+        Serial.print(heapBudget);
+        Serial.print(F(" bytes exceeded"));
+    }
+    Serial.println();
+    
+    return stats;
+}
@@ -11,6 +11,36 @@ static bool yMinusLatch = false;
 static bool xPlusLatch = false;
 static bool xMinusLatch = false;
 
+// Which way an axis is deflected: 1 towards its plus direction, -1
+// towards minus, 0 inside the dead zone. The single place the thresholds
+// and the axis inversion are applied.
+static int axisDirection(int value, bool inverted) {
+    if (value < JOYSTICK_LOW_THRESHOLD) return inverted ? -1 : 1;
+    if (value > JOYSTICK_HIGH_THRESHOLD) return inverted ? 1 : -1;
+    return 0;
+}
+
+static inline int yDirection() {
+    return axisDirection(analogRead(JOYSTICK_Y_PIN), JOYSTICK_INVERT_Y);
+}
+
+static inline int xDirection() {
+    return axisDirection(analogRead(JOYSTICK_X_PIN), JOYSTICK_INVERT_X);
+}
+
+// One press per deflection: fires on entering the direction, re-arms only
+// once the stick is back in the dead zone
+static bool latchPress(int direction, int wanted, bool* latch) {
+    if (direction == wanted && !*latch) {
+        *latch = true;
+        return true;
+    }
+    if (direction == 0) {
+        *latch = false;
+    }
+    return false;
+}
+
 void initControls() {
     pinMode(JOYSTICK_BUTTON_PIN, INPUT_PULLUP);
     
@@ -27,103 +57,27 @@ void initControls() {
     Serial.println(yValue);
     
     
-    
-    #if JOYSTICK_INVERT_Y
-        yMinusLatch = (yValue < JOYSTICK_LOW_THRESHOLD);
-        yPlusLatch = (yValue > JOYSTICK_HIGH_THRESHOLD);
-    #else
-        yPlusLatch = (yValue < JOYSTICK_LOW_THRESHOLD);
-        yMinusLatch = (yValue > JOYSTICK_HIGH_THRESHOLD);
-    #endif
-    
-    #if JOYSTICK_INVERT_X
-        xMinusLatch = (xValue < JOYSTICK_LOW_THRESHOLD);
-        xPlusLatch = (xValue > JOYSTICK_HIGH_THRESHOLD);
-    #else
-        xPlusLatch = (xValue < JOYSTICK_LOW_THRESHOLD);
-        xMinusLatch = (xValue > JOYSTICK_HIGH_THRESHOLD);
-    #endif
+    // A stick already deflected at boot does not count as a press
+    int yDir = axisDirection(yValue, JOYSTICK_INVERT_Y);
+    int xDir = axisDirection(xValue, JOYSTICK_INVERT_X);
+    yPlusLatch = yDir > 0;
+    yMinusLatch = yDir < 0;
+    xPlusLatch = xDir > 0;
+    xMinusLatch = xDir < 0;
 }
 
 void updateControls() {
-    int yValue = analogRead(JOYSTICK_Y_PIN);
-    int xValue = analogRead(JOYSTICK_X_PIN);
+    int yDir = yDirection();
+    int xDir = xDirection();
     bool buttonState = digitalRead(JOYSTICK_BUTTON_PIN) == LOW;
     
-    
-    controls.yPlusPressed = false;
-    controls.yMinusPressed = false;
-    controls.xPlusPressed = false;
-    controls.xMinusPressed = false;
+    controls.yPlusPressed = latchPress(yDir, 1, &yPlusLatch);
+    controls.yMinusPressed = latchPress(yDir, -1, &yMinusLatch);
+    controls.xPlusPressed = latchPress(xDir, 1, &xPlusLatch);
+    controls.xMinusPressed = latchPress(xDir, -1, &xMinusLatch);
     controls.buttonReleased = false;
     
     
-    #if JOYSTICK_INVERT_Y
-        
-        if (yValue < JOYSTICK_LOW_THRESHOLD && !yMinusLatch) {
-            controls.yMinusPressed = true;
-            yMinusLatch = true;
-        } else if (yValue >= JOYSTICK_LOW_THRESHOLD && yValue <= JOYSTICK_HIGH_THRESHOLD) {
-            yMinusLatch = false;
-        }
-        
-        if (yValue > JOYSTICK_HIGH_THRESHOLD && !yPlusLatch) {
-            controls.yPlusPressed = true;
-            yPlusLatch = true;
-        } else if (yValue >= JOYSTICK_LOW_THRESHOLD && yValue <= JOYSTICK_HIGH_THRESHOLD) {
-            yPlusLatch = false;
-        }
-    #else
-        
-        if (yValue < JOYSTICK_LOW_THRESHOLD && !yPlusLatch) {
-            controls.yPlusPressed = true;
-            yPlusLatch = true;
-        } else if (yValue >= JOYSTICK_LOW_THRESHOLD && yValue <= JOYSTICK_HIGH_THRESHOLD) {
-            yPlusLatch = false;
-        }
-        
-        if (yValue > JOYSTICK_HIGH_THRESHOLD && !yMinusLatch) {
-            controls.yMinusPressed = true;
-            yMinusLatch = true;
-        } else if (yValue >= JOYSTICK_LOW_THRESHOLD && yValue <= JOYSTICK_HIGH_THRESHOLD) {
-            yMinusLatch = false;
-        }
-    #endif
-    
-    
-    #if JOYSTICK_INVERT_X
-        
-        if (xValue < JOYSTICK_LOW_THRESHOLD && !xMinusLatch) {
-            controls.xMinusPressed = true;
-            xMinusLatch = true;
-        } else if (xValue >= JOYSTICK_LOW_THRESHOLD && xValue <= JOYSTICK_HIGH_THRESHOLD) {
-            xMinusLatch = false;
-        }
-        
-        if (xValue > JOYSTICK_HIGH_THRESHOLD && !xPlusLatch) {
-            controls.xPlusPressed = true;
-            xPlusLatch = true;
-        } else if (xValue >= JOYSTICK_LOW_THRESHOLD && xValue <= JOYSTICK_HIGH_THRESHOLD) {
-            xPlusLatch = false;
-        }
-    #else
-        
-        if (xValue < JOYSTICK_LOW_THRESHOLD && !xPlusLatch) {
-            controls.xPlusPressed = true;
-            xPlusLatch = true;
-        } else if (xValue >= JOYSTICK_LOW_THRESHOLD && xValue <= JOYSTICK_HIGH_THRESHOLD) {
-            xPlusLatch = false;
-        }
-        
-        if (xValue > JOYSTICK_HIGH_THRESHOLD && !xMinusLatch) {
-            controls.xMinusPressed = true;
-            xMinusLatch = true;
-        } else if (xValue >= JOYSTICK_LOW_THRESHOLD && xValue <= JOYSTICK_HIGH_THRESHOLD) {
-            xMinusLatch = false;
-        }
-    #endif
-    
-    
     controls.buttonPressed = buttonState;
     if (lastButtonState && !buttonState) {
         controls.buttonReleased = true;
@@ -155,6 +109,10 @@ bool isButtonHeld() {
     return controls.buttonPressed;
 }
 
+bool isRightHeld() {
+    return xDirection() > 0;
+}
+
 void waitForButtonRelease() {
     
     while (digitalRead(JOYSTICK_BUTTON_PIN) == LOW) {
@@ -1,18 +1,31 @@
 #include "cpp_app.h"
 #include "utils.h"
 #include "controls.h"
+#include "app_heap.h"
+#include "cpp_app_arena.h"
+#include "lua_app.h"
 #include <FlipperDisplay.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <string>
 #include <vector>
 
 extern FlipperDisplay* display;
 
 
-static std::vector<CppAppInfo> cppApps;
+extern "C" {
+    extern const CppAppDescriptor _cpp_app_registry_start[];
+    extern const CppAppDescriptor _cpp_app_registry_end[];
+}
 
 
 static volatile bool exitRequested = false;
-static std::string currentCppAppName;
+static const char* currentCppAppName = "";
+
+
+#define MAX_CPP_APP_CLEANUP_HOOKS 4
+static CppAppCleanup cleanupHooks[MAX_CPP_APP_CLEANUP_HOOKS];
+static int cleanupHookCount = 0;
 
 
 namespace CppApp {
@@ -158,64 +171,233 @@ namespace CppApp {
     bool shouldExit() {
         return exitRequested;
     }
+    
+    bool onExit(CppAppCleanup hook) {
+        if (!hook) return false;
+        for (int i = 0; i < cleanupHookCount; i++) {
+            if (cleanupHooks[i] == hook) return true;
+        }
+        if (cleanupHookCount >= MAX_CPP_APP_CLEANUP_HOOKS) {
+            Serial.println(F("C++ app: too many exit hooks"));
+            return false;
+        }
+        cleanupHooks[cleanupHookCount++] = hook;
+        return true;
+    }
 }
 
 
-void registerCppApp(const char* name, const char* uiPath, CppAppMain mainFunc) {
-    CppAppInfo info;
-    info.name = name;
-    info.uiPath = uiPath;
-    info.mainFunc = mainFunc;
-    cppApps.push_back(info);
-    
-    Serial.print(F("Registered C++ app: "));
-    Serial.print(name);
-    Serial.print(F(" at "));
-    Serial.println(uiPath);
+const CppAppDescriptor* cppAppsBegin() {
+    return _cpp_app_registry_start;
+}
+
+const CppAppDescriptor* cppAppsEnd() {
+    return _cpp_app_registry_end;
+}
+
+size_t getCppAppCount() {
+    return cppAppsEnd() - cppAppsBegin();
 }
 
-CppAppInfo* getCppApp(const char* name) {
-    for (auto& app : cppApps) {
-        if (app.name == name) {
-            return &app;
+const CppAppDescriptor* getCppApp(const char* name) {
+    for (const CppAppDescriptor* app = cppAppsBegin(); app != cppAppsEnd(); app++) {
+        if (strcmp(app->name, name) == 0) {
+            return app;
         }
     }
     return nullptr;
 }
 
-CppAppInfo* getCppAppByPath(const char* uiPath) {
-    for (auto& app : cppApps) {
-        if (app.uiPath == uiPath) {
-            return &app;
+const CppAppDescriptor* getCppAppByPath(const char* uiPath) {
+    uint32_t hash = cppAppPathHash(uiPath);
+    for (const CppAppDescriptor* app = cppAppsBegin(); app != cppAppsEnd(); app++) {
+        if (app->pathHash == hash && strcmp(app->uiPath, uiPath) == 0) {
+            return app;
         }
     }
     return nullptr;
 }
 
-std::vector<CppAppInfo>& getCppApps() {
-    return cppApps;
+
+// Each C++ app runs in its own task on core 1 so loop() keeps servicing
+// the launcher. The task owns the app from mainFunc() entry to return;
+// the runner below only watches it and never touches the app's input.
+enum class CppTaskState : uint8_t {
+    IDLE,
+    RUNNING,
+    FINISHED
+};
+
+static volatile CppTaskState taskState = CppTaskState::IDLE;
+static TaskHandle_t appTaskHandle = NULL;
+static uint32_t currentStackSize = 0;
+static volatile UBaseType_t stackHighWater = 0;
+static unsigned long buttonHoldStart = 0;
+static unsigned long forceExitDeadline = 0;
+
+static void cppAppTask(void* parameter) {
+    CppAppMain mainFunc = (CppAppMain)parameter;
+    
+    // Wait until the launcher has opened this task's heap scope
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    
+    mainFunc();
+    
+    // The runner deletes the task; deleting itself would free the TCB
+    // while the runner may still be about to suspend or delete it
+    stackHighWater = uxTaskGetStackHighWaterMark(NULL);
+    taskState = CppTaskState::FINISHED;
+    for (;;) {
+        vTaskSuspend(NULL);
+    }
 }
 
+// Only called once the app's task has returned or been deleted, so the
+// hooks never race the app and the hook list needs no lock
+static void runCleanupHooks() {
+    for (int i = 0; i < cleanupHookCount; i++) {
+        cleanupHooks[i]();
+    }
+    cleanupHookCount = 0;
+}
 
-static CppAppMain currentMainFunc = nullptr;
+static void finishCppApp(bool forced) {
+    runCleanupHooks();
+    cppArenaEnd();
+    appHeapEnd();
+    
+    Serial.print(F("C++ app "));
+    Serial.print(currentCppAppName);
+    Serial.print(forced ? F(" force-stopped") : F(" exited"));
+    Serial.print(F(", stack high-water: "));
+    Serial.print((uint32_t)stackHighWater);
+    Serial.print(F(" of "));
+    Serial.print(currentStackSize);
+    Serial.println(F(" bytes free"));
+    
+    appTaskHandle = NULL;
+    taskState = CppTaskState::IDLE;
+    exitRequested = false;
+    buttonHoldStart = 0;
+    forceExitDeadline = 0;
+    CppApp::resetInputFrame();
+}
+
+// Last resort for an app that ignored shouldExit(). A killed task never
+// gives back a mutex it holds; the display lock is tracked, so the app is
+// only killed between display operations, but a kill while it is inside
+// Serial, LittleFS or a network stack call can still wedge that driver.
+static bool forceStopCppApp() {
+    TaskHandle_t task = appTaskHandle;
+    if (!task) return true;
+    
+    vTaskSuspend(task);
+    
+    // Returned meanwhile: the runner deletes it on its next pass
+    if (taskState == CppTaskState::FINISHED) {
+        return false;
+    }
+    
+    if (isDisplayLockHeldBy(task)) {
+        vTaskResume(task);
+        return false;
+    }
+    
+    stackHighWater = uxTaskGetStackHighWaterMark(task);
+    vTaskDelete(task);
+    return true;
+}
 
 static AppState cppAppRunner() {
-    if (!currentMainFunc) {
+    if (taskState == CppTaskState::IDLE) {
+        return AppState::EXIT;
+    }
+    
+    if (taskState == CppTaskState::FINISHED) {
+        vTaskDelete(appTaskHandle);
+        finishCppApp(false);
         return AppState::EXIT;
     }
     
     
-    currentMainFunc();
+    if (digitalRead(JOYSTICK_BUTTON_PIN) == LOW) {
+        if (buttonHoldStart == 0) {
+            buttonHoldStart = millis();
+        } else if (forceExitDeadline == 0 && millis() - buttonHoldStart >= CPP_APP_FORCE_EXIT_HOLD_MS) {
+            Serial.println(F("C++ app: exit requested by long press"));
+            exitRequested = true;
+            forceExitDeadline = millis() + CPP_APP_EXIT_GRACE_MS;
+        }
+    } else {
+        buttonHoldStart = 0;
+    }
+    
+    if (forceExitDeadline == 0 && appHeapBudgetExceeded()) {
+        Serial.println(F("C++ app: heap budget exceeded, requesting exit"));
+        exitRequested = true;
+        forceExitDeadline = millis() + CPP_APP_EXIT_GRACE_MS;
+    }
+    
+    if (forceExitDeadline != 0 && (long)(millis() - forceExitDeadline) >= 0) {
+        if (forceStopCppApp()) {
+            finishCppApp(true);
+            return AppState::EXIT;
+        }
+    }
+    
+    delay(20);
+    return AppState::RUNNING;
+}
+
+static AppState launchCppApp(const CppAppDescriptor* app) {
+    if (taskState != CppTaskState::IDLE) {
+        Serial.print(F("C++ app already running: "));
+        Serial.println(currentCppAppName);
+        return AppState::EXIT;
+    }
     
+    // C++ apps (WiFi, BLE) need the memory a warm Lua VM holds on to
+    releaseWarmLuaVM();
     
-    currentMainFunc = nullptr;
     exitRequested = false;
+    cleanupHookCount = 0;
+    currentCppAppName = app->name;
+    currentStackSize = app->stackSize;
+    stackHighWater = 0;
+    buttonHoldStart = 0;
+    forceExitDeadline = 0;
+    CppApp::resetInputFrame();
+    
+    taskState = CppTaskState::RUNNING;
+    BaseType_t created = xTaskCreatePinnedToCore(
+        cppAppTask,
+        app->name,
+        app->stackSize,
+        (void*)app->mainFunc,
+        1,
+        &appTaskHandle,
+        1
+    );
+    
+    if (created != pdPASS) {
+        Serial.print(F("Failed to create task for C++ app: "));
+        Serial.println(app->name);
+        taskState = CppTaskState::IDLE;
+        appTaskHandle = NULL;
+        return AppState::EXIT;
+    }
     
-    return AppState::EXIT;
+    cppArenaBegin(app->name);
+    appHeapBegin(app->name, appTaskHandle, app->heapBudget);
+    xTaskNotifyGive(appTaskHandle);
+    
+    startApp(cppAppRunner);
+    
+    return AppState::RUNNING;
 }
 
 AppState runCppApp(const char* name) {
-    CppAppInfo* app = getCppApp(name);
+    const CppAppDescriptor* app = getCppApp(name);
     if (!app) {
         Serial.print(F("C++ app not found: "));
         Serial.println(name);
@@ -225,18 +407,11 @@ AppState runCppApp(const char* name) {
     Serial.print(F("Running C++ app: "));
     Serial.println(name);
     
-    exitRequested = false;
-    currentCppAppName = name;
-    currentMainFunc = app->mainFunc;
-    
-    
-    startApp(cppAppRunner);
-    
-    return AppState::RUNNING;
+    return launchCppApp(app);
 }
 
 AppState runCppAppByPath(const char* uiPath) {
-    CppAppInfo* app = getCppAppByPath(uiPath);
+    const CppAppDescriptor* app = getCppAppByPath(uiPath);
     if (!app) {
         Serial.print(F("C++ app not found at path: "));
         Serial.println(uiPath);
@@ -244,36 +419,35 @@ AppState runCppAppByPath(const char* uiPath) {
     }
     
     Serial.print(F("Running C++ app: "));
-    Serial.print(app->name.c_str());
+    Serial.print(app->name);
     Serial.print(F(" from "));
     Serial.println(uiPath);
     
-    exitRequested = false;
-    currentCppAppName = app->name;
-    currentMainFunc = app->mainFunc;
-    
-    
-    startApp(cppAppRunner);
-    
-    return AppState::RUNNING;
+    return launchCppApp(app);
 }
 
-#if __has_include("security_config.h")
-    #include "security_config.h"
-#else
-    #define ENABLE_BLE 0
-#endif
-
 void initCppApps() {
-    
-    registerDemoApps();
-    registerWifiApps();
-    registerIRApps();
-#if ENABLE_BLE
-    registerBLEApps();
-#endif
+    size_t count = getCppAppCount();
+    
+    // What the old heap registry (std::vector of name/path std::strings)
+    // would have allocated for the same set of apps.
+    size_t legacyBytes = count * (2 * sizeof(std::string) + sizeof(CppAppMain) + sizeof(uint32_t));
+    for (const CppAppDescriptor* app = cppAppsBegin(); app != cppAppsEnd(); app++) {
+        size_t nameLen = strlen(app->name);
+        size_t pathLen = strlen(app->uiPath);
+        if (nameLen > 15) legacyBytes += nameLen + 1;
+        if (pathLen > 15) legacyBytes += pathLen + 1;
+        
+        Serial.print(F("Registered C++ app: "));
+        Serial.print(app->name);
+        Serial.print(F(" at "));
+        Serial.println(app->uiPath);
+    }
     
     Serial.println(F("C++ app system initialized"));
     Serial.print(F("Registered apps: "));
-    Serial.println(cppApps.size());
+    Serial.print(count);
+    Serial.print(F(" (flash registry, "));
+    Serial.print(legacyBytes);
+    Serial.println(F(" bytes RAM saved)"));
 }
@@ -0,0 +1,264 @@
+#include "cpp_app_arena.h"
+#include "app_heap.h"
+#include "config.h"
+#include <esp_heap_caps.h>
+#include <new>
+
+// Chunks come from heap_caps_malloc and are charged to the app explicitly,
+// so the charge holds even though the launcher task frees them.
+struct ArenaChunk {
+    ArenaChunk* next;
+    uint32_t size;
+    uint32_t used;
+    uint32_t dedicated;
+};
+
+struct PoolBlock {
+    PoolBlock* next;
+};
+
+static const size_t POOL_CLASS_SIZES[] = { 16, 32, 64, 128 };
+#define POOL_CLASS_COUNT (sizeof(POOL_CLASS_SIZES) / sizeof(POOL_CLASS_SIZES[0]))
+
+// One level of nesting. Frames live here rather than in the ArenaScope,
+// which may sit on the stack of a task that gets force-stopped.
+struct ArenaFrame {
+    ArenaChunk* chunks;
+    PoolBlock* freeLists[POOL_CLASS_COUNT];
+    CppApp::ArenaStats stats;
+    bool active;
+};
+
+// frames[0] is the app's arena, frames[depth] the innermost open scope
+static ArenaFrame frames[1 + CPP_APP_ARENA_MAX_SCOPES];
+static int depth = 0;
+static const char* arenaOwner = "";
+
+
+static inline size_t alignUp(size_t bytes) {
+    return (bytes + 7) & ~(size_t)7;
+}
+
+static inline uint8_t* chunkData(ArenaChunk* chunk) {
+    return reinterpret_cast<uint8_t*>(chunk + 1);
+}
+
+static int poolClass(size_t bytes) {
+    for (size_t i = 0; i < POOL_CLASS_COUNT; i++) {
+        if (bytes <= POOL_CLASS_SIZES[i]) return (int)i;
+    }
+    return -1;
+}
+
+static ArenaChunk* reserveChunk(ArenaFrame* frame, size_t payload, bool dedicated) {
+    size_t total = sizeof(ArenaChunk) + payload;
+    ArenaChunk* chunk = static_cast<ArenaChunk*>(heap_caps_malloc(total, MALLOC_CAP_8BIT));
+    if (!chunk) return nullptr;
+    appHeapCharge(chunk);
+
+    chunk->next = nullptr;
+    chunk->size = payload;
+    chunk->used = 0;
+    chunk->dedicated = dedicated ? 1 : 0;
+    frame->stats.reservedBytes += total;
+    frame->stats.chunkCount++;
+    return chunk;
+}
+
+static void freeChunk(ArenaChunk* chunk) {
+    appHeapRelease(chunk);
+    heap_caps_free(chunk);
+}
+
+static void releaseChunk(ArenaFrame* frame, ArenaChunk* chunk) {
+    frame->stats.reservedBytes -= sizeof(ArenaChunk) + chunk->size;
+    frame->stats.chunkCount--;
+    freeChunk(chunk);
+}
+
+static void releaseFrame(ArenaFrame* frame) {
+    while (frame->chunks) {
+        ArenaChunk* next = frame->chunks->next;
+        freeChunk(frame->chunks);
+        frame->chunks = next;
+    }
+    memset(frame->freeLists, 0, sizeof(frame->freeLists));
+    frame->active = false;
+}
+
+static void openFrame(ArenaFrame* frame) {
+    memset(frame, 0, sizeof(*frame));
+    frame->active = true;
+}
+
+// The head of the list is the chunk currently being bump-allocated from;
+// dedicated chunks are linked in behind it.
+static void* bumpAlloc(ArenaFrame* frame, size_t bytes) {
+    ArenaChunk*& chunks = frame->chunks;
+    if (bytes > CPP_APP_ARENA_CHUNK_SIZE / 2) {
+        ArenaChunk* chunk = reserveChunk(frame, bytes, true);
+        if (!chunk) return nullptr;
+        chunk->used = bytes;
+        if (chunks) {
+            chunk->next = chunks->next;
+            chunks->next = chunk;
+        } else {
+            chunks = chunk;
+        }
+        return chunkData(chunk);
+    }
+
+    if (!chunks || chunks->dedicated || chunks->size - chunks->used < bytes) {
+        ArenaChunk* chunk = reserveChunk(frame, CPP_APP_ARENA_CHUNK_SIZE, false);
+        if (!chunk) return nullptr;
+        chunk->next = chunks;
+        chunks = chunk;
+    }
+
+    void* ptr = chunkData(chunks) + chunks->used;
+    chunks->used += bytes;
+    return ptr;
+}
+
+static ArenaChunk* findChunk(ArenaFrame* frame, const void* ptr, ArenaChunk** prevOut) {
+    const uint8_t* p = static_cast<const uint8_t*>(ptr);
+    ArenaChunk* prev = nullptr;
+    for (ArenaChunk* chunk = frame->chunks; chunk; prev = chunk, chunk = chunk->next) {
+        if (p >= chunkData(chunk) && p < chunkData(chunk) + chunk->size) {
+            if (prevOut) *prevOut = prev;
+            return chunk;
+        }
+    }
+    return nullptr;
+}
+
+
+namespace CppApp {
+    void* arenaAlloc(size_t bytes) {
+        ArenaFrame* frame = &frames[depth];
+        if (!frame->active) {
+            return ::operator new(bytes);
+        }
+
+        size_t size = alignUp(bytes);
+        int cls = poolClass(size);
+        void* ptr = nullptr;
+
+        if (cls >= 0) {
+            size = POOL_CLASS_SIZES[cls];
+            if (frame->freeLists[cls]) {
+                ptr = frame->freeLists[cls];
+                frame->freeLists[cls] = frame->freeLists[cls]->next;
+                frame->stats.pooledReuses++;
+            }
+        }
+
+        if (!ptr) ptr = bumpAlloc(frame, size);
+
+        if (!ptr) {
+            frame->stats.fallbackAllocs++;
+            return ::operator new(bytes);
+        }
+
+        frame->stats.allocCount++;
+        frame->stats.usedBytes += size;
+        if (frame->stats.usedBytes > frame->stats.peakUsedBytes) {
+            frame->stats.peakUsedBytes = frame->stats.usedBytes;
+        }
+        return ptr;
+    }
+
+    void arenaFree(void* ptr, size_t bytes) {
+        if (!ptr) return;
+
+        // The block may belong to any enclosing frame, not just the innermost
+        ArenaFrame* frame = nullptr;
+        ArenaChunk* prev = nullptr;
+        ArenaChunk* chunk = nullptr;
+        for (int level = depth; level >= 0 && !chunk; level--) {
+            frame = &frames[level];
+            if (frame->active) chunk = findChunk(frame, ptr, &prev);
+        }
+        if (!chunk) {
+            ::operator delete(ptr);
+            return;
+        }
+
+        size_t size = alignUp(bytes);
+        int cls = poolClass(size);
+
+        if (cls >= 0) {
+            size = POOL_CLASS_SIZES[cls];
+            PoolBlock* block = static_cast<PoolBlock*>(ptr);
+            block->next = frame->freeLists[cls];
+            frame->freeLists[cls] = block;
+        } else if (chunk->dedicated) {
+            if (prev) {
+                prev->next = chunk->next;
+            } else {
+                frame->chunks = chunk->next;
+            }
+            releaseChunk(frame, chunk);
+        } else if (chunk == frame->chunks && static_cast<uint8_t*>(ptr) + size == chunkData(chunk) + chunk->used) {
+            chunk->used -= size;
+        }
+
+        frame->stats.usedBytes -= size;
+    }
+
+    bool arenaActive() {
+        return frames[depth].active;
+    }
+
+    ArenaStats arenaStats() {
+        return frames[depth].stats;
+    }
+
+    ArenaScope::ArenaScope() : level(0) {
+        if (depth >= CPP_APP_ARENA_MAX_SCOPES) {
+            Serial.println(F("C++ app arena: too many nested scopes"));
+            return;
+        }
+        level = ++depth;
+        openFrame(&frames[level]);
+    }
+
+    ArenaScope::~ArenaScope() {
+        // Scopes close in reverse order on the task that opened them
+        if (level == 0 || level != depth) return;
+        releaseFrame(&frames[level]);
+        depth--;
+    }
+}
+
+
+void cppArenaBegin(const char* appName) {
+    if (depth > 0 || frames[0].chunks) cppArenaEnd(false);
+
+    openFrame(&frames[0]);
+    arenaOwner = appName ? appName : "";
+}
+
+CppApp::ArenaStats cppArenaEnd(bool report) {
+    // Scopes a force-stopped app never got to close
+    for (; depth > 0; depth--) {
+        releaseFrame(&frames[depth]);
+    }
+
+    CppApp::ArenaStats result = frames[0].stats;
+    releaseFrame(&frames[0]);
+
+    if (report && result.allocCount > 0) {
+        Serial.printf("[ARENA] %s: peak %u of %u bytes reserved in %u chunks, %u allocs, %u pooled reuses, %u heap fallbacks\n",
+                      arenaOwner,
+                      (unsigned)result.peakUsedBytes,
+                      (unsigned)result.reservedBytes,
+                      (unsigned)result.chunkCount,
+                      (unsigned)result.allocCount,
+                      (unsigned)result.pooledReuses,
+                      (unsigned)result.fallbackAllocs);
+    }
+
+    memset(&frames[0].stats, 0, sizeof(frames[0].stats));
+    return result;
+}
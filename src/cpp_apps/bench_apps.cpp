@@ -0,0 +1,435 @@
+#include "cpp_app.h"
+#include "lua_app.h"
+#include "lua_file.h"
+#include "lua_bind.h"
+#include <esp_heap_caps.h>
+#include <LittleFS.h>
+
+extern "C" {
+#include "lua/lauxlib.h"
+#include "lua/lualib.h"
+}
+
+#if ENABLE_BENCH_APPS
+
+#define ARENA_BENCH_CYCLES 50
+#define ARENA_BENCH_RECORDS 40
+#define ARENA_BENCH_FRAMES 20
+
+
+struct BenchRecord {
+    char name[33];
+    uint8_t mac[6];
+    int32_t rssi;
+};
+
+// One simulated launch/exit: a scan-sized record list, a list of long
+// labels and per-frame string building, like wifi_scanner. Halfway through
+// it makes one small allocation that outlives the "app" (a selection kept
+// for the next app), which is what pins holes in the general heap.
+template <typename RecordList, typename Str, typename LabelList>
+static void runBenchCycle(void** survivor) {
+    RecordList records;
+    LabelList labels;
+
+    for (int i = 0; i < ARENA_BENCH_RECORDS; i++) {
+        BenchRecord record;
+        snprintf(record.name, sizeof(record.name), "bench-network-%02d", i);
+        memset(record.mac, i, sizeof(record.mac));
+        record.rssi = -40 - i;
+        records.push_back(record);
+        labels.push_back(Str(record.name) + " (channel 11)");
+
+        if (i == ARENA_BENCH_RECORDS / 2) {
+            *survivor = malloc(24);
+        }
+    }
+
+    for (int frame = 0; frame < ARENA_BENCH_FRAMES; frame++) {
+        for (size_t i = 0; i < records.size(); i++) {
+            Str line = frame & 1 ? "> " : "  ";
+            line += labels[i];
+            if (records[i].rssi > -50) line += " +++";
+        }
+    }
+}
+
+static void printHeapLine(const char* label) {
+    Serial.printf("[ARENA BENCH] %s: largest free block %u, free %u\n",
+                  label,
+                  (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+                  (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT));
+}
+
+// Largest free block after ARENA_BENCH_CYCLES cycles, general heap first,
+// then the same workload in the C++ app arena.
+CPP_APP(arena_bench) {
+    static void* survivors[ARENA_BENCH_CYCLES];
+    char buf[40];
+
+    CppApp::clear();
+    CppApp::println("Arena bench");
+    CppApp::println("");
+    CppApp::println("Running...");
+    CppApp::refresh();
+
+    printHeapLine("start");
+    uint32_t baseline = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+    for (int i = 0; i < ARENA_BENCH_CYCLES; i++) {
+        runBenchCycle<std::vector<BenchRecord>, std::string, std::vector<std::string>>(&survivors[i]);
+    }
+    uint32_t heapLargest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    printHeapLine("general heap");
+
+    for (int i = 0; i < ARENA_BENCH_CYCLES; i++) {
+        free(survivors[i]);
+        survivors[i] = nullptr;
+    }
+
+    // A scope per cycle, like one app launch; the app's own arena stays up
+    for (int i = 0; i < ARENA_BENCH_CYCLES; i++) {
+        CppApp::ArenaScope scope;
+        runBenchCycle<CppApp::ArenaVector<BenchRecord>, CppApp::ArenaString,
+                      CppApp::ArenaVector<CppApp::ArenaString>>(&survivors[i]);
+    }
+    uint32_t arenaLargest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    printHeapLine("arena");
+
+    for (int i = 0; i < ARENA_BENCH_CYCLES; i++) {
+        free(survivors[i]);
+        survivors[i] = nullptr;
+    }
+
+    CppApp::clear();
+    CppApp::println("Arena bench");
+    snprintf(buf, sizeof(buf), "%d cycles, largest:", ARENA_BENCH_CYCLES);
+    CppApp::println(buf);
+    snprintf(buf, sizeof(buf), "start %u", (unsigned)baseline);
+    CppApp::println(buf);
+    snprintf(buf, sizeof(buf), "heap  %u", (unsigned)heapLargest);
+    CppApp::println(buf);
+    snprintf(buf, sizeof(buf), "arena %u", (unsigned)arenaLargest);
+    CppApp::println(buf);
+    CppApp::println("L:exit");
+    CppApp::refresh();
+
+    while (!CppApp::shouldExit() && !CppApp::left()) {
+        CppApp::waitFrame(50);
+    }
+}
+
+REGISTER_CPP_APP_EX(arena_bench, "/Applications/Bench/Arena", "app", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET);
+
+
+#define DRAW_BENCH_FRAMES 100
+
+// 200 tiles drawn four ways; each global function draws one frame
+static const char drawBenchScript[] =
+    "local N = 200\n"
+    "local function tile(i) return (i % 16) * 8, (i // 16) * 4 end\n"
+    "function perCall()\n"
+    "  for i = 0, N - 1 do local x, y = tile(i); display.fillRect(x, y, 7, 3) end\n"
+    "end\n"
+    "local ops = {}\n"
+    "for i = 0, N - 1 do local x, y = tile(i); ops[i + 1] = {display.FILL, x, y, 7, 3} end\n"
+    "function records() display.batch(ops) end\n"
+    "function recordsBuilt()\n"
+    "  local frame = {}\n"
+    "  for i = 0, N - 1 do local x, y = tile(i); frame[i + 1] = {display.FILL, x, y, 7, 3} end\n"
+    "  display.batch(frame)\n"
+    "end\n"
+    "local parts = {}\n"
+    "for i = 0, N - 1 do local x, y = tile(i); parts[i + 1] = string.pack('<Bhhhh', display.FILL, x, y, 7, 3) end\n"
+    "local packed = table.concat(parts)\n"
+    "function packedOps() display.batch(packed) end\n";
+
+static const char* const drawBenchCases[] = { "perCall", "records", "recordsBuilt", "packedOps" };
+#define DRAW_BENCH_CASE_COUNT (sizeof(drawBenchCases) / sizeof(drawBenchCases[0]))
+
+// Average time per 200-rect frame; returns 0 if the case failed
+static uint32_t timeDrawCase(lua_State* L, const char* name) {
+    uint32_t start = micros();
+    for (int frame = 0; frame < DRAW_BENCH_FRAMES; frame++) {
+        lua_getglobal(L, name);
+        if (lua_pcall(L, 0, 0, 0) != LUA_OK) {
+            Serial.printf("[DRAW BENCH] %s: %s\n", name, lua_tostring(L, -1));
+            lua_pop(L, 1);
+            return 0;
+        }
+    }
+    return (micros() - start) / DRAW_BENCH_FRAMES;
+}
+
+// Per-call display.fillRect versus display.batch() for a 200-rect frame
+CPP_APP(draw_bench) {
+    char buf[40];
+    uint32_t results[DRAW_BENCH_CASE_COUNT] = {0};
+
+    CppApp::clear();
+    CppApp::println("Draw bench");
+    CppApp::println("");
+    CppApp::println("Running...");
+    CppApp::refresh();
+
+    lua_State* L = luaL_newstate();
+    if (!L) {
+        CppApp::println("No memory for Lua");
+        CppApp::refresh();
+    } else {
+        luaL_requiref(L, LUA_GNAME, luaopen_base, 1);
+        luaL_requiref(L, "string", luaopen_string, 1);
+        luaL_requiref(L, "table", luaopen_table, 1);
+        luaL_requiref(L, "display", luaopen_display, 1);
+        lua_settop(L, 0);
+
+        if (luaL_dostring(L, drawBenchScript) != LUA_OK) {
+            Serial.printf("[DRAW BENCH] script: %s\n", lua_tostring(L, -1));
+        } else {
+            for (size_t i = 0; i < DRAW_BENCH_CASE_COUNT; i++) {
+                results[i] = timeDrawCase(L, drawBenchCases[i]);
+                Serial.printf("[DRAW BENCH] %s: %u us per 200-rect frame\n",
+                              drawBenchCases[i], (unsigned)results[i]);
+            }
+        }
+        lua_close(L);
+    }
+
+    CppApp::clear();
+    CppApp::println("Draw bench, us/frame");
+    for (size_t i = 0; i < DRAW_BENCH_CASE_COUNT; i++) {
+        snprintf(buf, sizeof(buf), "%-12s %u", drawBenchCases[i], (unsigned)results[i]);
+        CppApp::println(buf);
+    }
+    CppApp::println("L:exit");
+    CppApp::refresh();
+
+    while (!CppApp::shouldExit() && !CppApp::left()) {
+        CppApp::waitFrame(50);
+    }
+}
+
+REGISTER_CPP_APP_EX(draw_bench, "/Applications/Bench/Draw", "app", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET);
+
+#define FILE_BENCH_PATH "/storage/file_bench.txt"
+#define FILE_BENCH_BYTES (100 * 1024)
+
+static const char fileBenchScript[] =
+    "function lines(path)\n"
+    "  local f = filesystem.open(path)\n"
+    "  local n = 0\n"
+    "  for line in f:lines() do n = n + 1 end\n"
+    "  f:close()\n"
+    "  return n\n"
+    "end\n"
+    "function readLine(path)\n"
+    "  local f = filesystem.open(path)\n"
+    "  local n = 0\n"
+    "  while f:readLine() do n = n + 1 end\n"
+    "  f:close()\n"
+    "  return n\n"
+    "end\n";
+
+static const char* const fileBenchCases[] = { "lines", "readLine" };
+#define FILE_BENCH_CASE_COUNT (sizeof(fileBenchCases) / sizeof(fileBenchCases[0]))
+
+// ~100 KB of log-like lines of varying length
+static bool writeFileBenchData() {
+    File file = LittleFS.open(FILE_BENCH_PATH, "w");
+    if (!file) return false;
+    char line[96];
+    size_t written = 0;
+    for (int i = 0; written < FILE_BENCH_BYTES; i++) {
+        int len = snprintf(line, sizeof(line), "%06d,sensor-%02d,%d.%02d,%s\n",
+                           i, i % 16, i % 97, i % 100, (i & 3) ? "ok" : "threshold exceeded, retrying");
+        written += file.write((const uint8_t*)line, len);
+    }
+    file.close();
+    return true;
+}
+
+// What the table-based handle did per line: Arduino String readStringUntil
+static uint32_t timeStringLines(uint32_t* lines) {
+    uint32_t start = micros();
+    File file = LittleFS.open(FILE_BENCH_PATH, "r");
+    *lines = 0;
+    while (file.available()) {
+        String line = file.readStringUntil('\n');
+        (*lines)++;
+    }
+    file.close();
+    return micros() - start;
+}
+
+static uint32_t timeLuaLines(lua_State* L, const char* name, uint32_t* lines) {
+    uint32_t start = micros();
+    lua_getglobal(L, name);
+    lua_pushstring(L, FILE_BENCH_PATH);
+    if (lua_pcall(L, 1, 1, 0) != LUA_OK) {
+        Serial.printf("[FILE BENCH] %s: %s\n", name, lua_tostring(L, -1));
+        lua_pop(L, 1);
+        return 0;
+    }
+    *lines = (uint32_t)lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    return micros() - start;
+}
+
+// Reading a 100 KB file line by line through the File userdata
+CPP_APP(file_bench) {
+    char buf[40];
+    uint32_t stringUs = 0, stringLines = 0;
+    uint32_t results[FILE_BENCH_CASE_COUNT] = {0};
+    uint32_t lines[FILE_BENCH_CASE_COUNT] = {0};
+
+    CppApp::clear();
+    CppApp::println("File bench");
+    CppApp::println("");
+    CppApp::println("Running...");
+    CppApp::refresh();
+
+    bool ready = writeFileBenchData();
+    lua_State* L = ready ? luaL_newstate() : nullptr;
+    if (L) {
+        luaL_requiref(L, LUA_GNAME, luaopen_base, 1);
+        luaL_requiref(L, "filesystem", luaopen_filesystem, 1);
+        lua_settop(L, 0);
+
+        stringUs = timeStringLines(&stringLines);
+        Serial.printf("[FILE BENCH] String::readStringUntil: %u us, %u lines\n",
+                      (unsigned)stringUs, (unsigned)stringLines);
+
+        if (luaL_dostring(L, fileBenchScript) != LUA_OK) {
+            Serial.printf("[FILE BENCH] script: %s\n", lua_tostring(L, -1));
+        } else {
+            for (size_t i = 0; i < FILE_BENCH_CASE_COUNT; i++) {
+                results[i] = timeLuaLines(L, fileBenchCases[i], &lines[i]);
+                Serial.printf("[FILE BENCH] Lua %s: %u us, %u lines\n",
+                              fileBenchCases[i], (unsigned)results[i], (unsigned)lines[i]);
+            }
+        }
+        lua_close(L);
+    }
+    LittleFS.remove(FILE_BENCH_PATH);
+
+    CppApp::clear();
+    CppApp::println("File bench, 100 KB");
+    if (!ready) {
+        CppApp::println("Could not write file");
+    } else {
+        snprintf(buf, sizeof(buf), "String   %u ms", (unsigned)(stringUs / 1000));
+        CppApp::println(buf);
+        for (size_t i = 0; i < FILE_BENCH_CASE_COUNT; i++) {
+            snprintf(buf, sizeof(buf), "%-8s %u ms", fileBenchCases[i], (unsigned)(results[i] / 1000));
+            CppApp::println(buf);
+        }
+        snprintf(buf, sizeof(buf), "%u lines", (unsigned)stringLines);
+        CppApp::println(buf);
+    }
+    CppApp::println("L:exit");
+    CppApp::refresh();
+
+    while (!CppApp::shouldExit() && !CppApp::left()) {
+        CppApp::waitFrame(50);
+    }
+}
+
+REGISTER_CPP_APP_EX(file_bench, "/Applications/Bench/File", "app", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET);
+
+#define BIND_BENCH_CALLS 100000
+
+static int benchAdd(int a, int b) {
+    return a + b;
+}
+
+static bool benchFlag() {
+    return (micros() & 1) != 0;
+}
+
+static int benchHandAdd(lua_State* L) {
+    int a = luaL_checkinteger(L, 1);
+    int b = luaL_checkinteger(L, 2);
+    lua_pushinteger(L, benchAdd(a, b));
+    return 1;
+}
+
+static int benchHandFlag(lua_State* L) {
+    lua_pushboolean(L, benchFlag());
+    return 1;
+}
+
+static const char bindBenchScript[] =
+    "function run(f, n)\n"
+    "  for i = 1, n do f(i, 1) end\n"
+    "end\n";
+
+static const struct {
+    const char* label;
+    lua_CFunction fn;
+} bindBenchCases[] = {
+    { "add hand", benchHandAdd },
+    { "add bind", LUA_BIND(benchAdd) },
+    { "flag hand", benchHandFlag },
+    { "flag bind", LUA_BIND(benchFlag) },
+};
+#define BIND_BENCH_CASE_COUNT (sizeof(bindBenchCases) / sizeof(bindBenchCases[0]))
+
+static uint32_t timeBindCase(lua_State* L, lua_CFunction fn) {
+    uint32_t start = micros();
+    lua_getglobal(L, "run");
+    lua_pushcfunction(L, fn);
+    lua_pushinteger(L, BIND_BENCH_CALLS);
+    if (lua_pcall(L, 2, 0, 0) != LUA_OK) {
+        Serial.printf("[BIND BENCH] %s\n", lua_tostring(L, -1));
+        lua_pop(L, 1);
+        return 0;
+    }
+    return micros() - start;
+}
+
+// Per-call cost of LUA_BIND wrappers against the hand-written equivalent
+CPP_APP(bind_bench) {
+    char buf[40];
+    uint32_t results[BIND_BENCH_CASE_COUNT] = {0};
+
+    CppApp::clear();
+    CppApp::println("Bind bench");
+    CppApp::println("");
+    CppApp::println("Running...");
+    CppApp::refresh();
+
+    lua_State* L = luaL_newstate();
+    if (L) {
+        luaL_requiref(L, LUA_GNAME, luaopen_base, 1);
+        lua_settop(L, 0);
+        if (luaL_dostring(L, bindBenchScript) != LUA_OK) {
+            Serial.printf("[BIND BENCH] script: %s\n", lua_tostring(L, -1));
+        } else {
+            for (size_t i = 0; i < BIND_BENCH_CASE_COUNT; i++) {
+                results[i] = timeBindCase(L, bindBenchCases[i].fn);
+                Serial.printf("[BIND BENCH] %s: %u us for %u calls, %u ns/call\n",
+                              bindBenchCases[i].label, (unsigned)results[i], (unsigned)BIND_BENCH_CALLS,
+                              (unsigned)((uint64_t)results[i] * 1000 / BIND_BENCH_CALLS));
+            }
+        }
+        lua_close(L);
+    }
+
+    CppApp::clear();
+    CppApp::println("Bind bench, ns/call");
+    for (size_t i = 0; i < BIND_BENCH_CASE_COUNT; i++) {
+        snprintf(buf, sizeof(buf), "%-9s %u", bindBenchCases[i].label,
+                 (unsigned)((uint64_t)results[i] * 1000 / BIND_BENCH_CALLS));
+        CppApp::println(buf);
+    }
+    CppApp::println("L:exit");
+    CppApp::refresh();
+
+    while (!CppApp::shouldExit() && !CppApp::left()) {
+        CppApp::waitFrame(50);
+    }
+}
+
+REGISTER_CPP_APP_EX(bind_bench, "/Applications/Bench/Bind", "app", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET);
+
+#endif
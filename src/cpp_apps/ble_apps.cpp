@@ -20,6 +20,8 @@ BleKeyboard* bleKeyboard = nullptr;
 
 // Simple BLE Rickroller - advertises as a legitimate-looking Cherry keyboard
 CPP_APP(ble_rickroller) {
+    CppApp::onExit(cleanupBLEKeyboard);
+    
     Serial.println("BLE Rickroller: Starting...");
     
     // Clean up any previous BLE
@@ -87,11 +89,13 @@ CPP_APP(ble_rickroller) {
     Serial.println("BLE Rickroller: Exiting");
 }
 
-REGISTER_CPP_APP(ble_rickroller, "/Applications/BLE/Rickroller");
+REGISTER_CPP_APP_EX(ble_rickroller, "/Applications/BLE/Rickroller", "bluetooth", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET);
 
 // BLE Keyboard Attack - Educational demonstration of BLE HID attacks
 
 CPP_APP(ble_keyboard_attack) {
+    CppApp::onExit(cleanupBLEKeyboard);
+    
     Serial.println("BLE Keyboard Attack: Starting...");
     
     // Clean up any previous BLE initialization
@@ -342,7 +346,7 @@ CPP_APP(ble_keyboard_attack) {
     Serial.println("BLE Keyboard Attack: Exiting");
 }
 
-REGISTER_CPP_APP(ble_keyboard_attack, "/Applications/BLE/Keyboard Attack");
+REGISTER_CPP_APP_EX(ble_keyboard_attack, "/Applications/BLE/Keyboard Attack", "bluetooth", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET);
 
 // Function to force cleanup of BLE keyboard (called from Lua BLE code)
 void cleanupBLEKeyboard() {
@@ -359,10 +363,3 @@ void cleanupBLEKeyboard() {
 
 #endif
 
-void registerBLEApps() {
-#if ENABLE_BLE
-    registerCppApp("ble_rickroller", "/Applications/BLE/Rickroller", cppapp_ble_rickroller);
-    registerCppApp("ble_keyboard_attack", "/Applications/BLE/Keyboard Attack", cppapp_ble_keyboard_attack);
-#endif
-}
-
@@ -109,9 +109,4 @@ CPP_APP(reaction) {
     }
 }
 
-REGISTER_CPP_APP(reaction, "/Games/reaction");
-
-
-void registerDemoApps() {
-    registerCppApp("reaction", "/Games/reaction", cppapp_reaction);
-}
+REGISTER_CPP_APP_EX(reaction, "/Games/reaction", "game", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET);
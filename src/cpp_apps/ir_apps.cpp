@@ -40,7 +40,7 @@ CPP_APP(ir_remote) {
     char currentFolder[64] = "";
     char currentCodeName[64] = "";
     const TVCode* currentCode = nullptr;
-    std::vector<const TVCode*> codes;  // Cached codes list for current folder
+    CppApp::ArenaVector<const TVCode*> codes;  // Cached codes list for current folder
     
     // Get available protocols
     const char** protocols = getIRProtocols();
@@ -57,18 +57,22 @@ CPP_APP(ir_remote) {
     };
     
     // Store string objects for custom folders to keep pointers valid
-    static std::vector<std::string> customFolderStrings;
+    CppApp::ArenaVector<CppApp::ArenaString> customFolderStrings;
     
     // Helper: Get brands for current protocol
-    auto getBrands = [&]() -> std::vector<const char*> {
-        std::vector<const char*> brands;
+    auto getBrands = [&]() -> CppApp::ArenaVector<const char*> {
+        CppApp::ArenaVector<const char*> brands;
         if (protocolIndex >= numProtocols || !protocols[protocolIndex]) return brands;
         
         const char* protoName = protocols[protocolIndex];
         
         if (strcasecmp_eq(protoName, "Custom")) {
             // Store String objects persistently to keep pointers valid
-            customFolderStrings = getCustomFolders();
+            std::vector<std::string> folders = getCustomFolders();
+            customFolderStrings.clear();
+            for (const auto& f : folders) {
+                customFolderStrings.emplace_back(f.c_str());
+            }
             for (const auto& f : customFolderStrings) {
                 brands.push_back(f.c_str());
             }
@@ -94,12 +98,14 @@ CPP_APP(ir_remote) {
     };
     
     // Helper: Get codes for brand
-    auto getCodesForBrand = [&](const char* brand) -> std::vector<const TVCode*> {
-        std::vector<const TVCode*> codes;
+    auto getCodesForBrand = [&](const char* brand) -> CppApp::ArenaVector<const TVCode*> {
+        CppApp::ArenaVector<const TVCode*> codes;
         const char* protoName = protocols[protocolIndex];
         
         if (strcasecmp_eq(protoName, "Custom")) {
-            return getCustomCodes(brand);
+            std::vector<const TVCode*> custom = getCustomCodes(brand);
+            codes.assign(custom.begin(), custom.end());
+            return codes;
         }
         
         for (int i = 0; i < numCodes; i++) {
@@ -133,7 +139,7 @@ CPP_APP(ir_remote) {
             
         } else if (navLevel == BRAND) {
             // Brand/Folder selection
-            std::vector<const char*> brands = getBrands();
+            CppApp::ArenaVector<const char*> brands = getBrands();
             bool isCustom = isCustomProtocol();
             int maxIndex = brands.size() + (isCustom ? 1 : 0);
             
@@ -167,7 +173,7 @@ CPP_APP(ir_remote) {
             
         } else if (navLevel == CODE_LIST) {
             // Inside folder/brand - list codes
-            std::vector<const TVCode*> codes = getCodesForBrand(currentFolder);
+            CppApp::ArenaVector<const TVCode*> codes = getCodesForBrand(currentFolder);
             bool isCustom = isCustomProtocol();
             
             // For custom: codes + "New entry" + "Delete folder"
@@ -290,7 +296,7 @@ CPP_APP(ir_remote) {
                 render();
             }
             if (rightPressed) {
-                std::vector<const char*> brands = getBrands();
+                CppApp::ArenaVector<const char*> brands = getBrands();
                 if (brands.size() > 0 || isCustomProtocol()) {
                     navLevel = BRAND;
                     brandIndex = 0;
@@ -299,7 +305,7 @@ CPP_APP(ir_remote) {
             }
             
         } else if (navLevel == BRAND) {
-            std::vector<const char*> brands = getBrands();
+            CppApp::ArenaVector<const char*> brands = getBrands();
             bool isCustom = isCustomProtocol();
             int maxIndex = brands.size() + (isCustom ? 1 : 0);
             
@@ -551,7 +557,9 @@ CPP_APP(ir_remote) {
     }
 }
 
-REGISTER_CPP_APP(ir_remote, "/Applications/Infrared/Universal Remote");
+#if ENABLE_ADVANCED_IR
+REGISTER_CPP_APP_EX(ir_remote, "/Applications/Infrared/Universal Remote", "ir", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET);
+#endif
 
 // Simple IR Test App
 CPP_APP(ir_test) {
@@ -611,12 +619,6 @@ CPP_APP(ir_test) {
     }
 }
 
-REGISTER_CPP_APP(ir_test, "/Applications/Infrared/IR Test");
-
-void registerIRApps() {
 #if ENABLE_ADVANCED_IR
-    registerCppApp("Universal Remote", "/Applications/Infrared/Universal Remote", cppapp_ir_remote);
-    registerCppApp("IR Test", "/Applications/Infrared/IR Test", cppapp_ir_test);
-    // TV-B-Gone is now implemented in Lua
+REGISTER_CPP_APP_EX(ir_test, "/Applications/Infrared/IR Test", "ir", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET);
 #endif
-}
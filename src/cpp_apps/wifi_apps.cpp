@@ -24,14 +24,17 @@
 
 
 struct NetworkInfo {
-    String ssid;
+    char ssid[33];
     uint8_t bssid[6];
     int32_t rssi;
     uint8_t channel;
     wifi_auth_mode_t encType;
 };
 
-static std::vector<NetworkInfo> scannedNetworks;
+// Scan results live in the running app's arena; only the selection below
+// outlives the app and stays on the general heap.
+typedef CppApp::ArenaVector<NetworkInfo> NetworkList;
+
 static bool scanComplete = false;
 
 
@@ -39,41 +42,48 @@ static String selectedNetworkSSID = "";
 static std::vector<NetworkInfo> selectedNetworkBSSIDs;  
 
 
-static void updateSelectedNetworkBSSIDs() {
+static void updateSelectedNetworkBSSIDs(const NetworkList& networks) {
     selectedNetworkBSSIDs.clear();
-    for (const auto& net : scannedNetworks) {
-        if (net.ssid == selectedNetworkSSID) {
+    for (const auto& net : networks) {
+        if (selectedNetworkSSID == net.ssid) {
             selectedNetworkBSSIDs.push_back(net);
         }
     }
 }
 
-static void scanNetworks() {
-    scannedNetworks.clear();
+static void scanNetworks(NetworkList& networks) {
+    networks.clear();
 
     WiFi.mode(WIFI_STA);
     WiFi.disconnect();
     delay(100);
 
     int n = WiFi.scanNetworks(false, true);
+    if (n > 0) networks.reserve(n);
 
     for (int i = 0; i < n; i++) {
         NetworkInfo info;
-        info.ssid = WiFi.SSID(i);
-        if (info.ssid.length() == 0) {
-            info.ssid = "(Hidden)";
-        }
+        String ssid = WiFi.SSID(i);
+        strlcpy(info.ssid, ssid.length() > 0 ? ssid.c_str() : "(Hidden)", sizeof(info.ssid));
         memcpy(info.bssid, WiFi.BSSID(i), 6);
         info.rssi = WiFi.RSSI(i);
         info.channel = WiFi.channel(i);
         info.encType = WiFi.encryptionType(i);
-        scannedNetworks.push_back(info);
+        networks.push_back(info);
     }
 
     WiFi.scanDelete();
     scanComplete = true;
 }
 
+static void releaseScanResults() {
+    WiFi.scanDelete();
+}
+
+static void stopWiFiRadio() {
+    WiFi.mode(WIFI_OFF);
+}
+
 
 
 
@@ -159,10 +169,12 @@ static void sendBeacon(uint8_t line) {
 
 
 CPP_APP(wifi_scanner) {
+    CppApp::onExit(releaseScanResults);
+    
     int selectedIndex = 0;
     bool needsRender = true;
     scanComplete = false;
-    scannedNetworks.clear();
+    NetworkList scannedNetworks;
     
     CppApp::clear();
     CppApp::println("WiFi Scanner");
@@ -170,7 +182,7 @@ CPP_APP(wifi_scanner) {
     CppApp::println("Scanning...");
     CppApp::refresh();
     
-    scanNetworks();
+    scanNetworks(scannedNetworks);
     needsRender = true;  
     
     while (!CppApp::shouldExit()) {
@@ -190,7 +202,7 @@ CPP_APP(wifi_scanner) {
         
         if (select && selectedIndex >= 0 && selectedIndex < (int)scannedNetworks.size()) {
             selectedNetworkSSID = scannedNetworks[selectedIndex].ssid;
-            updateSelectedNetworkBSSIDs();
+            updateSelectedNetworkBSSIDs(scannedNetworks);
             break;
         }
         
@@ -221,11 +233,11 @@ CPP_APP(wifi_scanner) {
                 
                 for (int i = startIdx; i < endIdx; i++) {
                     bool selected = (i == selectedIndex);
-                    String line = selected ? "> " : "  ";
+                    CppApp::ArenaString line = selected ? "> " : "  ";
                     
-                    String ssid = scannedNetworks[i].ssid;
+                    CppApp::ArenaString ssid = scannedNetworks[i].ssid;
                     if (ssid.length() > 12) {
-                        ssid = ssid.substring(0, 9) + "...";
+                        ssid = ssid.substr(0, 9) + "...";
                     }
                     line += ssid;
                     
@@ -249,13 +261,17 @@ CPP_APP(wifi_scanner) {
     }
 }
 
-REGISTER_CPP_APP(wifi_scanner, "/Applications/WiFi/Scanner");
+#if ENABLE_ADVANCED_WIFI
+REGISTER_CPP_APP_EX(wifi_scanner, "/Applications/WiFi/Scanner", "wifi", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET);
+#endif
 
 
 
 
 
 CPP_APP(wifi_deauther) {
+    CppApp::onExit(stopWiFiRadio);
+    
     bool running = false;
     int packetCount = 0;
     int currentBSSID = 0;
@@ -340,13 +356,17 @@ CPP_APP(wifi_deauther) {
     WiFi.mode(WIFI_OFF);
 }
 
-REGISTER_CPP_APP(wifi_deauther, "/Applications/WiFi/Deauther");
+#if ENABLE_ADVANCED_WIFI
+REGISTER_CPP_APP_EX(wifi_deauther, "/Applications/WiFi/Deauther", "wifi", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET);
+#endif
 
 
 
 
 
 CPP_APP(wifi_rickroll) {
+    CppApp::onExit(stopWiFiRadio);
+    
     bool running = false;
     int packetCount = 0;
     unsigned long lastRender = 0;
@@ -406,13 +426,17 @@ CPP_APP(wifi_rickroll) {
     WiFi.mode(WIFI_OFF);
 }
 
-REGISTER_CPP_APP(wifi_rickroll, "/Applications/WiFi/Rickroll");
+#if ENABLE_ADVANCED_WIFI
+REGISTER_CPP_APP_EX(wifi_rickroll, "/Applications/WiFi/Rickroll", "wifi", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET);
+#endif
 
 
 
 
 
 CPP_APP(wifi_combo) {
+    CppApp::onExit(stopWiFiRadio);
+    
     bool running = false;
     int deauthCount = 0;
     int beaconCount = 0;
@@ -510,13 +534,17 @@ CPP_APP(wifi_combo) {
     WiFi.mode(WIFI_OFF);
 }
 
-REGISTER_CPP_APP(wifi_combo, "/Applications/WiFi/Deauth+Rick");
+#if ENABLE_ADVANCED_WIFI
+REGISTER_CPP_APP_EX(wifi_combo, "/Applications/WiFi/Deauth+Rick", "wifi", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET);
+#endif
 
 CPP_APP(wifi_settings) {
+    CppApp::onExit(releaseScanResults);
+    
     int selectedIndex = 0;
     bool needsRender = true;
     scanComplete = false;
-    scannedNetworks.clear();
+    NetworkList scannedNetworks;
     
     char savedSSID[64] = {0};
     char savedPassword[128] = {0};
@@ -536,7 +564,7 @@ CPP_APP(wifi_settings) {
     CppApp::refresh();
     
     showLoadingScreenOverlay("Scanning WiFi...");
-    scanNetworks();
+    scanNetworks(scannedNetworks);
     hideLoadingScreenOverlay();
     needsRender = true;
     
@@ -628,7 +656,7 @@ CPP_APP(wifi_settings) {
                 CppApp::waitFrame(10);
             }
             
-            scanNetworks();
+            scanNetworks(scannedNetworks);
             selectedIndex = 0;
             needsRender = true;
         }
@@ -660,11 +688,11 @@ CPP_APP(wifi_settings) {
                 
                 for (int i = startIdx; i < endIdx; i++) {
                     bool selected = (i == selectedIndex);
-                    String line = selected ? "> " : "  ";
+                    CppApp::ArenaString line = selected ? "> " : "  ";
                     
-                    String ssid = scannedNetworks[i].ssid;
+                    CppApp::ArenaString ssid = scannedNetworks[i].ssid;
                     if (ssid.length() > 12) {
-                        ssid = ssid.substring(0, 9) + "...";
+                        ssid = ssid.substr(0, 9) + "...";
                     }
                     line += ssid;
                     
@@ -692,7 +720,9 @@ CPP_APP(wifi_settings) {
     }
 }
 
-REGISTER_CPP_APP(wifi_settings, "/Settings/WiFi");
+#if ENABLE_ADVANCED_WIFI
+REGISTER_CPP_APP_EX(wifi_settings, "/Settings/WiFi", "wifi", CPP_APP_STACK_SIZE, CPP_APP_HEAP_BUDGET);
+#endif
 
 // Captive Portal - Evil Twin with fake login pages
 static WebServer* portalServer = nullptr;
@@ -700,6 +730,21 @@ static DNSServer* dnsServer = nullptr;
 static std::vector<String> capturedCreds;
 static bool portalRunning = false;
 
+static void stopCaptivePortal() {
+    if (portalServer) {
+        portalServer->stop();
+        delete portalServer;
+        portalServer = nullptr;
+    }
+    if (dnsServer) {
+        dnsServer->stop();
+        delete dnsServer;
+        dnsServer = nullptr;
+    }
+    WiFi.softAPdisconnect(true);
+    portalRunning = false;
+}
+
 String readHTMLFile(const char* path) {
     if (!LittleFS.exists(path)) {
         Serial.printf("HTML file not found: %s\n", path);
@@ -764,6 +809,8 @@ void handlePost() {
 }
 
 CPP_APP(captive_portal) {
+    CppApp::onExit(stopCaptivePortal);
+    
     char ssid[64] = "Free WiFi";
     
     // Get custom SSID from keyboard
@@ -785,18 +832,7 @@ CPP_APP(captive_portal) {
     
     // Stop any existing portal
     if (portalRunning) {
-        if (portalServer) {
-            portalServer->stop();
-            delete portalServer;
-            portalServer = nullptr;
-        }
-        if (dnsServer) {
-            dnsServer->stop();
-            delete dnsServer;
-            dnsServer = nullptr;
-        }
-        WiFi.softAPdisconnect(true);
-        portalRunning = false;
+        stopCaptivePortal();
     }
     
     capturedCreds.clear();
@@ -937,18 +973,7 @@ CPP_APP(captive_portal) {
     
     // Cleanup
     Serial.println("Captive Portal: Stopping");
-    if (portalServer) {
-        portalServer->stop();
-        delete portalServer;
-        portalServer = nullptr;
-    }
-    if (dnsServer) {
-        dnsServer->stop();
-        delete dnsServer;
-        dnsServer = nullptr;
-    }
-    WiFi.softAPdisconnect(true);
-    portalRunning = false;
+    stopCaptivePortal();
     
     // Show captured credentials - only update display when navigating
     if (capturedCreds.size() > 0) {
@@ -1022,15 +1047,6 @@ CPP_APP(captive_portal) {
     Serial.println("Captive Portal: Exiting");
 }
 
-REGISTER_CPP_APP(captive_portal, "/Applications/WiFi/Captive Portal");
-
-void registerWifiApps() {
 #if ENABLE_ADVANCED_WIFI
-    registerCppApp("wifi_scanner", "/Applications/WiFi/Scanner", cppapp_wifi_scanner);
-    registerCppApp("wifi_deauther", "/Applications/WiFi/Deauther", cppapp_wifi_deauther);
-    registerCppApp("wifi_rickroll", "/Applications/WiFi/Rickroll", cppapp_wifi_rickroll);
-    registerCppApp("wifi_combo", "/Applications/WiFi/Deauth+Rick", cppapp_wifi_combo);
-    registerCppApp("captive_portal", "/Applications/WiFi/Captive Portal", cppapp_captive_portal);
-    registerCppApp("wifi_settings", "/Settings/WiFi", cppapp_wifi_settings);
+REGISTER_CPP_APP_EX(captive_portal, "/Applications/WiFi/Captive Portal", "wifi", 12288, CPP_APP_HEAP_BUDGET);
 #endif
-}
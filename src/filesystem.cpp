@@ -162,8 +162,10 @@ static void scanFolderRecursive(const std::string& fsPath, const std::string& ui
             rawName = rawName.substr(lastSlash + 1);
         }
         
-        // Skip hidden files
-        if (rawName.length() > 0 && rawName[0] == '.') {
+        // Skip hidden files, bytecode caches (lua_bytecode.h) and the
+        // temporary copies left by an unfinished atomic write (lua_fs.h)
+        if ((rawName.length() > 0 && rawName[0] == '.') ||
+            endsWith(rawName, ".luac") || endsWith(rawName, ".tmp")) {
             file.close();
             file = dir.openNextFile();
             continue;
@@ -333,6 +335,19 @@ void scanAndCacheFolderStructure() {
     Serial.println(F(" filesystem entries"));
 }
 
+void rescanDynamicFolders() {
+    // Scanned entries are the ones that point at a real file or folder
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].targetPath.empty()) {
+            if (kept != i) entries[kept] = entries[i];
+            kept++;
+        }
+    }
+    entries.resize(kept);
+    scanAndCacheFolderStructure();
+}
+
 std::vector<FSEntry> getEntriesInDir(const std::string& dirPath) {
     std::vector<FSEntry> result;
     
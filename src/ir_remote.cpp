@@ -549,67 +549,77 @@ bool initIRReceiver() {
     return true;
 }
 
-bool scanIRCode(uint32_t timeoutMs, TVCode* outCode, char* protocolName, size_t protocolNameLen) {
+void beginIRScan() {
+    // Clear any pending results
+    irrecv.resume();
+}
+
+bool pollIRCode(TVCode* outCode, char* protocolName, size_t protocolNameLen) {
     if (!outCode || !protocolName) return false;
     
-    uint32_t startTime = millis();
     decode_results results;
+    if (irrecv.decode(&results)) {
+        // Convert decode_type_t to string - use fixed buffer to avoid String allocation
+        // typeToString returns a String, so we need to extract it to a char buffer
+        String protoStr = typeToString(results.decode_type);
+        const char* protoCStr = protoStr.c_str();
+        
+        // Copy and convert to uppercase in fixed buffer
+        size_t len = strlen(protoCStr);
+        if (len >= protocolNameLen) len = protocolNameLen - 1;
+        
+        for (size_t i = 0; i < len; i++) {
+            char c = protoCStr[i];
+            protocolName[i] = (c >= 'a' && c <= 'z') ? (c - 32) : c;
+        }
+        protocolName[len] = '\0';
+        
+        // Store in TVCode (fixed-size char array copy)
+        strncpy(outCode->protocol, protocolName, sizeof(outCode->protocol) - 1);
+        outCode->protocol[sizeof(outCode->protocol) - 1] = '\0';
+        
+        outCode->nbits = results.bits;
+        
+        if (results.decode_type == NEC) {
+            // NEC: address is upper 16 bits, command is bits 15-8 (middle 8 bits)
+            // Lower 8 bits are inverted command (auto-generated by library)
+            outCode->address = (results.value >> 16) & 0xFFFF;
+            outCode->command = (results.value >> 8) & 0xFF;
+        } else if (results.decode_type == SONY) {
+            // Sony: just use the value
+            outCode->address = 0;
+            outCode->command = results.value;
+        } else if (results.decode_type == RC5 || results.decode_type == RC6) {
+            // RC5/RC6: address and command combined
+            outCode->address = (results.value >> 6) & 0x1F;
+            outCode->command = results.value & 0x3F;
+        } else if (results.decode_type == SAMSUNG) {
+            // Samsung: full value
+            outCode->address = 0;
+            outCode->command = results.value;
+        } else {
+            // Generic: use value as command
+            outCode->address = 0;
+            outCode->command = results.value;
+        }
+        
+        outCode->brand[0] = '\0'; // Will be set when saving
+        outCode->button[0] = '\0'; // Will be set when saving
+        
+        irrecv.resume();
+        return true;
+    }
+    return false;
+}
+
+bool scanIRCode(uint32_t timeoutMs, TVCode* outCode, char* protocolName, size_t protocolNameLen) {
+    if (!outCode || !protocolName) return false;
     
-    // Clear any pending results
-    irrecv.resume();
+    uint32_t startTime = millis();
+    beginIRScan();
     
     while (millis() - startTime < timeoutMs) {
-        if (irrecv.decode(&results)) {
-            // Convert decode_type_t to string - use fixed buffer to avoid String allocation
-            // typeToString returns a String, so we need to extract it to a char buffer
-            String protoStr = typeToString(results.decode_type);
-            const char* protoCStr = protoStr.c_str();
-            
-            // Copy and convert to uppercase in fixed buffer
-            size_t len = strlen(protoCStr);
-            if (len >= protocolNameLen) len = protocolNameLen - 1;
-            
-            for (size_t i = 0; i < len; i++) {
-                char c = protoCStr[i];
-                protocolName[i] = (c >= 'a' && c <= 'z') ? (c - 32) : c;
-            }
-            protocolName[len] = '\0';
-            
-            // Store in TVCode (fixed-size char array copy)
-            strncpy(outCode->protocol, protocolName, sizeof(outCode->protocol) - 1);
-            outCode->protocol[sizeof(outCode->protocol) - 1] = '\0';
-            
-            outCode->nbits = results.bits;
-            
-            if (results.decode_type == NEC) {
-                // NEC: address is upper 16 bits, command is bits 15-8 (middle 8 bits)
-                // Lower 8 bits are inverted command (auto-generated by library)
-                outCode->address = (results.value >> 16) & 0xFFFF;
-                outCode->command = (results.value >> 8) & 0xFF;
-            } else if (results.decode_type == SONY) {
-                // Sony: just use the value
-                outCode->address = 0;
-                outCode->command = results.value;
-            } else if (results.decode_type == RC5 || results.decode_type == RC6) {
-                // RC5/RC6: address and command combined
-                outCode->address = (results.value >> 6) & 0x1F;
-                outCode->command = results.value & 0x3F;
-            } else if (results.decode_type == SAMSUNG) {
-                // Samsung: full value
-                outCode->address = 0;
-                outCode->command = results.value;
-            } else {
-                // Generic: use value as command
-                outCode->address = 0;
-                outCode->command = results.value;
-            }
-            
-            outCode->brand[0] = '\0'; // Will be set when saving
-            outCode->button[0] = '\0'; // Will be set when saving
-            
-            irrecv.resume();
-            return true;
-        }
+        if (pollIRCode(outCode, protocolName, protocolNameLen)) return true;
         delay(10);
     }
     
@@ -320,149 +320,160 @@ static void drawKeyboard(const char* title, const char* buffer) {
     requestDisplayRefresh();
 }
 
-bool showKeyboard(const char* title, char* buffer, size_t maxLen) {
+void keyboardBegin(const char* title, char* buffer, size_t maxLen) {
     k_sel_x = 0;
     k_sel_y = 0;
     k_shift = false;
     cursor_pos = strlen(buffer);
     
+    drawKeyboard(title, buffer);
+}
+
+bool keyboardStep(const char* title, char* buffer, size_t maxLen, bool* confirmed) {
     bool done = false;
     bool confirm = false;
+    bool changed = false;
     
-    drawKeyboard(title, buffer);
     
-    while (!done) {
-        updateControls();
-        bool changed = false;
-        
-        
-        if (isUpPressed()) {
-            if (k_sel_y > 0) k_sel_y--;
-            else k_sel_y = K_ROWS - 1; 
-            changed = true;
-        }
-        if (isDownPressed()) {
-            if (k_sel_y < K_ROWS - 1) k_sel_y++;
-            else k_sel_y = 0; 
-            changed = true;
-        }
-        if (isLeftPressed()) {
-            if (k_sel_x > 0) k_sel_x--;
-            else k_sel_x = K_COLS - 1; 
-            changed = true;
+    if (isUpPressed()) {
+        if (k_sel_y > 0) k_sel_y--;
+        else k_sel_y = K_ROWS - 1; 
+        changed = true;
+    }
+    if (isDownPressed()) {
+        if (k_sel_y < K_ROWS - 1) k_sel_y++;
+        else k_sel_y = 0; 
+        changed = true;
+    }
+    if (isLeftPressed()) {
+        if (k_sel_x > 0) k_sel_x--;
+        else k_sel_x = K_COLS - 1; 
+        changed = true;
+    }
+    if (isRightPressed()) {
+        if (k_sel_x < K_COLS - 1) k_sel_x++;
+        else k_sel_x = 0; 
+        changed = true;
         }
-        if (isRightPressed()) {
-            if (k_sel_x < K_COLS - 1) k_sel_x++;
-            else k_sel_x = 0; 
-            changed = true;
-            }
-        
+    
+    
+    if (isButtonReleased()) {
+        changed = true;
+        size_t len = strlen(buffer);
         
-        if (isButtonReleased()) {
-            changed = true;
-            size_t len = strlen(buffer);
+        if (k_sel_x < 10) {
             
-            if (k_sel_x < 10) {
+            if (len < maxLen - 1) {
                 
+                for (int i = len; i >= cursor_pos; i--) {
+                    buffer[i + 1] = buffer[i];
+                }
+                char c = getKeyChar(k_sel_x, k_sel_y);
+                buffer[cursor_pos] = (c == '_') ? ' ' : c;
+                cursor_pos++;
+            }
+        } else if (k_sel_x == 10) {
+            
+            if (k_sel_y == 0) { 
+                k_shift = !k_shift;
+            } else if (k_sel_y == 1) { 
+                if (cursor_pos > 0) {
+                    for (int i = cursor_pos - 1; i < len; i++) {
+                        buffer[i] = buffer[i + 1];
+                    }
+                    cursor_pos--;
+                }
+            } else if (k_sel_y == 2) { 
+                done = true;
+                confirm = true;
+            } else if (k_sel_y == 3) { 
                 if (len < maxLen - 1) {
-                    
-                    for (int i = len; i >= cursor_pos; i--) {
+                     for (int i = len; i >= cursor_pos; i--) {
                         buffer[i + 1] = buffer[i];
                     }
-                    char c = getKeyChar(k_sel_x, k_sel_y);
-                    buffer[cursor_pos] = (c == '_') ? ' ' : c;
+                    buffer[cursor_pos] = '\n';
                     cursor_pos++;
                 }
-            } else if (k_sel_x == 10) {
+            }
+        } else if (k_sel_x == 11) {
+            
+            if (k_sel_y == 1) { 
+                if (cursor_pos > 0) cursor_pos--;
+            } else if (k_sel_y == 3) { 
+                if (cursor_pos < len) cursor_pos++;
+            } else if (k_sel_y == 0) { 
                 
-                if (k_sel_y == 0) { 
-                    k_shift = !k_shift;
-                } else if (k_sel_y == 1) { 
-                    if (cursor_pos > 0) {
-                        for (int i = cursor_pos - 1; i < len; i++) {
-                            buffer[i] = buffer[i + 1];
-                        }
-                        cursor_pos--;
-                    }
-                } else if (k_sel_y == 2) { 
-                    done = true;
-                    confirm = true;
-                } else if (k_sel_y == 3) { 
-                    if (len < maxLen - 1) {
-                         for (int i = len; i >= cursor_pos; i--) {
-                            buffer[i + 1] = buffer[i];
-                        }
-                        buffer[cursor_pos] = '\n';
-                        cursor_pos++;
+                int curLineStart = 0;
+                for (int i = cursor_pos - 1; i >= 0; i--) {
+                    if (buffer[i] == '\n') {
+                        curLineStart = i + 1;
+                        break;
                     }
                 }
-            } else if (k_sel_x == 11) {
+                int col = cursor_pos - curLineStart;
                 
-                if (k_sel_y == 1) { 
-                    if (cursor_pos > 0) cursor_pos--;
-                } else if (k_sel_y == 3) { 
-                    if (cursor_pos < len) cursor_pos++;
-                } else if (k_sel_y == 0) { 
+                if (curLineStart > 0) {
                     
-                    int curLineStart = 0;
-                    for (int i = cursor_pos - 1; i >= 0; i--) {
+                    int prevLineStart = 0;
+                    for (int i = curLineStart - 2; i >= 0; i--) {
                         if (buffer[i] == '\n') {
-                            curLineStart = i + 1;
+                            prevLineStart = i + 1;
                             break;
                         }
                     }
-                    int col = cursor_pos - curLineStart;
                     
-                    if (curLineStart > 0) {
-                        
-                        int prevLineStart = 0;
-                        for (int i = curLineStart - 2; i >= 0; i--) {
-                            if (buffer[i] == '\n') {
-                                prevLineStart = i + 1;
-                                break;
-                            }
-                        }
-                        
-                        int prevLineLen = curLineStart - 1 - prevLineStart;
-                        int newCol = (col > prevLineLen) ? prevLineLen : col;
-                        cursor_pos = prevLineStart + newCol;
-                    }
-                } else if (k_sel_y == 2) { 
-                     
-                    int curLineStart = 0;
-                    for (int i = cursor_pos - 1; i >= 0; i--) {
-                        if (buffer[i] == '\n') {
-                            curLineStart = i + 1;
-                            break;
-                        }
-                    }
-                    int col = cursor_pos - curLineStart;
-                    
-                    
-                    int nextLineStart = -1;
-                    for (int i = cursor_pos; i < len; i++) {
-                        if (buffer[i] == '\n') {
-                            nextLineStart = i + 1;
-                            break;
+                    int prevLineLen = curLineStart - 1 - prevLineStart;
+                    int newCol = (col > prevLineLen) ? prevLineLen : col;
+                    cursor_pos = prevLineStart + newCol;
                 }
-            }
-                    
-                    if (nextLineStart != -1) {
-                         int nextLineLen = 0;
-                         for (int i = nextLineStart; i < len; i++) {
-                             if (buffer[i] == '\n') break;
-                             nextLineLen++;
-                         }
-                         int newCol = (col > nextLineLen) ? nextLineLen : col;
-                         cursor_pos = nextLineStart + newCol;
+            } else if (k_sel_y == 2) { 
+                 
+                int curLineStart = 0;
+                for (int i = cursor_pos - 1; i >= 0; i--) {
+                    if (buffer[i] == '\n') {
+                        curLineStart = i + 1;
+                        break;
                     }
                 }
+                int col = cursor_pos - curLineStart;
+                
+                
+                int nextLineStart = -1;
+                for (int i = cursor_pos; i < len; i++) {
+                    if (buffer[i] == '\n') {
+                        nextLineStart = i + 1;
+                        break;
             }
         }
-        
-        if (changed) {
-            drawKeyboard(title, buffer);
+                
+                if (nextLineStart != -1) {
+                     int nextLineLen = 0;
+                     for (int i = nextLineStart; i < len; i++) {
+                         if (buffer[i] == '\n') break;
+                         nextLineLen++;
+                     }
+                     int newCol = (col > nextLineLen) ? nextLineLen : col;
+                     cursor_pos = nextLineStart + newCol;
+                }
+            }
         }
+    }
+    
+    if (changed) {
+        drawKeyboard(title, buffer);
+    }
+    
+    if (confirmed) *confirmed = confirm;
+    return done;
+}
+
+bool showKeyboard(const char* title, char* buffer, size_t maxLen) {
+    bool confirm = false;
+    keyboardBegin(title, buffer, maxLen);
+    
+    while (true) {
+        updateControls();
+        if (keyboardStep(title, buffer, maxLen, &confirm)) break;
         delay(20);
     }
     
@@ -0,0 +1,113 @@
+#include "lua_bitmap.h"
+#include <LittleFS.h>
+
+static LuaBitmap* bitmaps = nullptr;
+
+
+static inline uint16_t readU16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline size_t frameBytes(const LuaBitmap* bitmap) {
+    return (size_t)((bitmap->width + 7) / 8) * bitmap->height;
+}
+
+static LuaBitmap* loadBitmap(const char* path, const char** error) {
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+        *error = "file not found";
+        return nullptr;
+    }
+
+    uint8_t header[LUA_BITMAP_HEADER_SIZE];
+    if (file.read(header, sizeof(header)) != sizeof(header) ||
+        header[0] != LUA_BITMAP_MAGIC_0 || header[1] != LUA_BITMAP_MAGIC_1) {
+        file.close();
+        *error = "not a 1bpp bitmap";
+        return nullptr;
+    }
+
+    LuaBitmap* bitmap = new LuaBitmap();
+    bitmap->width = readU16(header + 2);
+    bitmap->height = readU16(header + 4);
+    bitmap->frames = readU16(header + 6);
+    size_t dataSize = frameBytes(bitmap) * bitmap->frames;
+
+    if (dataSize == 0 || file.size() != LUA_BITMAP_HEADER_SIZE + dataSize) {
+        file.close();
+        delete bitmap;
+        *error = "bitmap size does not match its header";
+        return nullptr;
+    }
+
+    bitmap->data = static_cast<uint8_t*>(malloc(dataSize));
+    bitmap->path = strdup(path);
+    if (!bitmap->data || !bitmap->path) {
+        file.close();
+        free(bitmap->data);
+        free(bitmap->path);
+        delete bitmap;
+        *error = "not enough memory";
+        return nullptr;
+    }
+
+    size_t read = file.read(bitmap->data, dataSize);
+    file.close();
+    if (read != dataSize) {
+        free(bitmap->data);
+        free(bitmap->path);
+        delete bitmap;
+        *error = "read failed";
+        return nullptr;
+    }
+    return bitmap;
+}
+
+
+LuaBitmap* luaBitmapAcquire(const char* path, const char** error) {
+    for (LuaBitmap* bitmap = bitmaps; bitmap; bitmap = bitmap->next) {
+        if (strcmp(bitmap->path, path) == 0) {
+            bitmap->refs++;
+            return bitmap;
+        }
+    }
+
+    LuaBitmap* bitmap = loadBitmap(path, error);
+    if (!bitmap) return nullptr;
+
+    bitmap->refs = 1;
+    bitmap->next = bitmaps;
+    bitmaps = bitmap;
+    return bitmap;
+}
+
+void luaBitmapRelease(LuaBitmap* bitmap) {
+    if (!bitmap || --bitmap->refs > 0) return;
+
+    for (LuaBitmap** link = &bitmaps; *link; link = &(*link)->next) {
+        if (*link == bitmap) {
+            *link = bitmap->next;
+            break;
+        }
+    }
+    free(bitmap->data);
+    free(bitmap->path);
+    delete bitmap;
+}
+
+void luaBitmapDraw(FlipperDisplay* display, const LuaBitmap* bitmap, int x, int y, int frame, bool invert) {
+    if (!display || !bitmap || frame < 0 || frame >= bitmap->frames) return;
+
+    luaBitmapBlit(display, bitmap->data + frameBytes(bitmap) * frame, bitmap->width, bitmap->height, x, y, invert);
+}
+
+void luaBitmapBlit(FlipperDisplay* display, const uint8_t* pixels, int w, int h, int x, int y, bool invert) {
+    if (!display || !pixels || w <= 0 || h <= 0) return;
+
+    if (invert) {
+        display->fillRect(x, y, w, h, COLOR_WHITE);
+        display->drawBitmap(x, y, pixels, w, h, COLOR_BLACK);
+    } else {
+        display->drawBitmap(x, y, pixels, w, h, COLOR_WHITE);
+    }
+}
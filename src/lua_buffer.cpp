@@ -0,0 +1,251 @@
+#include "lua_buffer.h"
+#include <string.h>
+
+extern "C" {
+#include "lua/lauxlib.h"
+}
+
+#define LUA_BUFFER_MAX_BYTES (256 * 1024)
+
+static const char* const viewNames[] = { "u8", "u16", "u32", NULL };
+static const uint8_t viewWidths[] = { 1, 2, 4 };
+
+
+static const char* viewName(uint8_t width) {
+    return width == 1 ? "u8" : (width == 2 ? "u16" : "u32");
+}
+
+static uint8_t checkView(lua_State* L, int index, const char* def) {
+    return viewWidths[luaL_checkoption(L, index, def, viewNames)];
+}
+
+static inline uint32_t readElement(const LuaBuffer* buffer, uint32_t i) {
+    const uint8_t* p = buffer->data + i * buffer->width;
+    switch (buffer->width) {
+        case 1: return p[0];
+        case 2: return p[0] | (p[1] << 8);
+        default: return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+}
+
+static inline void writeElement(LuaBuffer* buffer, uint32_t i, uint32_t value) {
+    uint8_t* p = buffer->data + i * buffer->width;
+    p[0] = value;
+    if (buffer->width >= 2) p[1] = value >> 8;
+    if (buffer->width == 4) {
+        p[2] = value >> 16;
+        p[3] = value >> 24;
+    }
+}
+
+static LuaBuffer* newBuffer(lua_State* L, uint32_t bytes, uint8_t width) {
+    LuaBuffer* buffer = (LuaBuffer*)lua_newuserdatauv(L, sizeof(LuaBuffer) + bytes, 1);
+    buffer->data = reinterpret_cast<uint8_t*>(buffer + 1);
+    buffer->bytes = bytes;
+    buffer->width = width;
+    luaL_setmetatable(L, LUA_BUFFER_METATABLE);
+    return buffer;
+}
+
+// Resolves a 1-based inclusive element range, negative indices counting
+// from the end; returns false when it is empty
+static bool checkRange(lua_State* L, const LuaBuffer* buffer, int firstArg, uint32_t* first, uint32_t* last) {
+    lua_Integer count = luaBufferCount(buffer);
+    lua_Integer from = luaL_optinteger(L, firstArg, 1);
+    lua_Integer to = luaL_optinteger(L, firstArg + 1, count);
+    if (from < 0) from += count + 1;
+    if (to < 0) to += count + 1;
+    if (from < 1) from = 1;
+    if (to > count) to = count;
+    if (from > to) return false;
+    *first = (uint32_t)from - 1;
+    *last = (uint32_t)to - 1;
+    return true;
+}
+
+
+LuaBuffer* luaBufferTest(lua_State* L, int index) {
+    return (LuaBuffer*)luaL_testudata(L, index, LUA_BUFFER_METATABLE);
+}
+
+LuaBuffer* luaBufferCheck(lua_State* L, int index) {
+    return (LuaBuffer*)luaL_checkudata(L, index, LUA_BUFFER_METATABLE);
+}
+
+
+static int lua_buffer_new(lua_State* L) {
+    lua_Integer count = luaL_checkinteger(L, 1);
+    uint8_t width = checkView(L, 2, "u8");
+    luaL_argcheck(L, count >= 0 && count * width <= LUA_BUFFER_MAX_BYTES, 1, "size out of range");
+    
+    LuaBuffer* buffer = newBuffer(L, (uint32_t)count * width, width);
+    memset(buffer->data, 0, buffer->bytes);
+    return 1;
+}
+
+static int lua_buffer_fromString(lua_State* L) {
+    size_t len;
+    const char* str = luaL_checklstring(L, 1, &len);
+    uint8_t width = checkView(L, 2, "u8");
+    luaL_argcheck(L, len <= LUA_BUFFER_MAX_BYTES, 1, "string too long");
+    
+    LuaBuffer* buffer = newBuffer(L, (uint32_t)len, width);
+    memcpy(buffer->data, str, len);
+    return 1;
+}
+
+static int lua_buffer_index(lua_State* L) {
+    LuaBuffer* buffer = luaBufferCheck(L, 1);
+    if (lua_type(L, 2) != LUA_TNUMBER) {
+        lua_getmetatable(L, 1);
+        lua_pushvalue(L, 2);
+        lua_rawget(L, -2);
+        return 1;
+    }
+    lua_Integer i = lua_tointeger(L, 2);
+    if (i < 1 || i > (lua_Integer)luaBufferCount(buffer)) {
+        lua_pushnil(L);
+    } else {
+        lua_pushinteger(L, readElement(buffer, (uint32_t)i - 1));
+    }
+    return 1;
+}
+
+static int lua_buffer_newindex(lua_State* L) {
+    LuaBuffer* buffer = luaBufferCheck(L, 1);
+    lua_Integer i = luaL_checkinteger(L, 2);
+    luaL_argcheck(L, i >= 1 && i <= (lua_Integer)luaBufferCount(buffer), 2, "index out of range");
+    writeElement(buffer, (uint32_t)i - 1, (uint32_t)luaL_checkinteger(L, 3));
+    return 0;
+}
+
+static int lua_buffer_len(lua_State* L) {
+    lua_pushinteger(L, luaBufferCount(luaBufferCheck(L, 1)));
+    return 1;
+}
+
+static int lua_buffer_tostring(lua_State* L) {
+    LuaBuffer* buffer = luaBufferCheck(L, 1);
+    lua_pushfstring(L, "Buffer(%s, %d)", viewName(buffer->width), (int)luaBufferCount(buffer));
+    return 1;
+}
+
+// buf:bytes() - size in bytes, whatever the view
+static int lua_buffer_bytes(lua_State* L) {
+    lua_pushinteger(L, luaBufferCheck(L, 1)->bytes);
+    return 1;
+}
+
+// buf:view(type) - the same bytes read as another element type
+static int lua_buffer_view(lua_State* L) {
+    LuaBuffer* buffer = luaBufferCheck(L, 1);
+    uint8_t width = checkView(L, 2, NULL);
+    
+    LuaBuffer* view = (LuaBuffer*)lua_newuserdatauv(L, sizeof(LuaBuffer), 1);
+    view->data = buffer->data;
+    view->bytes = buffer->bytes;
+    view->width = width;
+    luaL_setmetatable(L, LUA_BUFFER_METATABLE);
+    
+    // Anchor the buffer that owns the bytes (a view's own anchor if this is one)
+    if (lua_getiuservalue(L, 1, 1) == LUA_TNIL) {
+        lua_pop(L, 1);
+        lua_pushvalue(L, 1);
+    }
+    lua_setiuservalue(L, -2, 1);
+    return 1;
+}
+
+// buf:fill(value[, first[, last]])
+static int lua_buffer_fill(lua_State* L) {
+    LuaBuffer* buffer = luaBufferCheck(L, 1);
+    uint32_t value = (uint32_t)luaL_checkinteger(L, 2);
+    uint32_t first, last;
+    if (!checkRange(L, buffer, 3, &first, &last)) return 0;
+    
+    if (buffer->width == 1 || value == 0) {
+        memset(buffer->data + first * buffer->width, value & 0xFF, (last - first + 1) * buffer->width);
+    } else {
+        for (uint32_t i = first; i <= last; i++) {
+            writeElement(buffer, i, value);
+        }
+    }
+    return 0;
+}
+
+// buf:copy(src[, at[, first[, last]]]) - src elements first..last into buf
+// from element at; returns the number of elements copied
+static int lua_buffer_copy(lua_State* L) {
+    LuaBuffer* dst = luaBufferCheck(L, 1);
+    LuaBuffer* src = luaBufferCheck(L, 2);
+    lua_Integer at = luaL_optinteger(L, 3, 1);
+    luaL_argcheck(L, at >= 1, 3, "index out of range");
+    
+    uint32_t first, last;
+    uint32_t dstCount = luaBufferCount(dst);
+    if (!checkRange(L, src, 4, &first, &last) || (uint32_t)at > dstCount) {
+        lua_pushinteger(L, 0);
+        return 1;
+    }
+    uint32_t n = last - first + 1;
+    if (n > dstCount - (uint32_t)(at - 1)) n = dstCount - (uint32_t)(at - 1);
+    
+    uint8_t* to = dst->data + (at - 1) * dst->width;
+    const uint8_t* from = src->data + first * src->width;
+    if (dst->width == src->width) {
+        memmove(to, from, n * src->width);
+        lua_pushinteger(L, n);
+        return 1;
+    }
+    
+    // Views of different widths over the same bytes advance at different
+    // rates, so no copy direction is safe; convert from a snapshot instead
+    LuaBuffer source = { const_cast<uint8_t*>(from), n * src->width, src->width };
+    if (to < from + n * src->width && from < to + n * dst->width) {
+        source.data = (uint8_t*)lua_newuserdatauv(L, source.bytes, 0);
+        memcpy(source.data, from, source.bytes);
+    }
+    for (uint32_t i = 0; i < n; i++) writeElement(dst, at - 1 + i, readElement(&source, i));
+    lua_pushinteger(L, n);
+    return 1;
+}
+
+// buf:toString([first[, last]]) - the raw bytes of an element range
+static int lua_buffer_toString(lua_State* L) {
+    LuaBuffer* buffer = luaBufferCheck(L, 1);
+    uint32_t first, last;
+    if (!checkRange(L, buffer, 2, &first, &last)) {
+        lua_pushliteral(L, "");
+        return 1;
+    }
+    lua_pushlstring(L, (const char*)buffer->data + first * buffer->width, (last - first + 1) * buffer->width);
+    return 1;
+}
+
+int luaopen_buffer(lua_State* L) {
+    static const luaL_Reg bufferMethods[] = {
+        {"__index", lua_buffer_index},
+        {"__newindex", lua_buffer_newindex},
+        {"__len", lua_buffer_len},
+        {"__tostring", lua_buffer_tostring},
+        {"bytes", lua_buffer_bytes},
+        {"view", lua_buffer_view},
+        {"fill", lua_buffer_fill},
+        {"copy", lua_buffer_copy},
+        {"toString", lua_buffer_toString},
+        {NULL, NULL}
+    };
+    static const luaL_Reg bufferLib[] = {
+        {"new", lua_buffer_new},
+        {"fromString", lua_buffer_fromString},
+        {NULL, NULL}
+    };
+    
+    if (luaL_newmetatable(L, LUA_BUFFER_METATABLE)) {
+        luaL_setfuncs(L, bufferMethods, 0);
+    }
+    lua_pop(L, 1);
+    
+    luaL_newlib(L, bufferLib);
+    return 1;
+}
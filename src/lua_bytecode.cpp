@@ -0,0 +1,169 @@
+#include "lua_bytecode.h"
+#include <LittleFS.h>
+
+#define LUA_CHUNK_READ_SIZE 512
+
+
+struct ChunkReader {
+    File* file;
+    char buffer[LUA_CHUNK_READ_SIZE];
+};
+
+static const char* readChunk(lua_State* L, void* ud, size_t* size) {
+    ChunkReader* reader = static_cast<ChunkReader*>(ud);
+    int read = reader->file->read(reinterpret_cast<uint8_t*>(reader->buffer), sizeof(reader->buffer));
+    *size = read > 0 ? (size_t)read : 0;
+    return *size > 0 ? reader->buffer : nullptr;
+}
+
+static int writeChunk(lua_State* L, const void* data, size_t size, void* ud) {
+    File* file = static_cast<File*>(ud);
+    return file->write(static_cast<const uint8_t*>(data), size) == size ? 0 : 1;
+}
+
+
+uint32_t luaSourceHash(const char* data, size_t len, uint32_t hash) {
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+std::string luaBytecodePath(const char* scriptPath) {
+    return std::string(scriptPath) + "c";
+}
+
+// False if the read stopped short, in which case key is not the source's
+static bool hashSourceFile(File& file, ChunkReader* reader, LuaChunkKey* key) {
+    key->sourceSize = file.size();
+    key->sourceHash = luaSourceHash(nullptr, 0);
+    
+    uint32_t total = 0;
+    int read;
+    while ((read = file.read(reinterpret_cast<uint8_t*>(reader->buffer), sizeof(reader->buffer))) > 0) {
+        key->sourceHash = luaSourceHash(reader->buffer, read, key->sourceHash);
+        total += read;
+    }
+    return total == key->sourceSize;
+}
+
+int luaLoadScriptFile(lua_State* L, const char* scriptPath, bool useCache, bool* fromCache) {
+    *fromCache = false;
+    
+    File file = LittleFS.open(scriptPath, "r");
+    if (!file) {
+        lua_pushfstring(L, "cannot open %s", scriptPath);
+        return LUA_ERRFILE;
+    }
+    
+    ChunkReader* reader = new ChunkReader;
+    reader->file = &file;
+    LuaChunkKey key = { 0, 0 };
+    
+    if (useCache) {
+        if (!hashSourceFile(file, reader, &key)) {
+            useCache = false;
+        } else if (luaLoadCachedChunk(L, scriptPath, key)) {
+            delete reader;
+            file.close();
+            *fromCache = true;
+            return LUA_OK;
+        }
+        
+        // Compiling from where the hash left off would load an empty
+        // chunk and cache it under the real key
+        if (!file.seek(0)) {
+            delete reader;
+            file.close();
+            lua_pushfstring(L, "cannot read %s", scriptPath);
+            return LUA_ERRFILE;
+        }
+    }
+    
+    Serial.print(F("Compiling script: "));
+    Serial.print(scriptPath);
+    Serial.print(F(" ("));
+    Serial.print(file.size());
+    Serial.println(F(" bytes)"));
+    
+    std::string chunkName = std::string("@") + scriptPath;
+    int status = lua_load(L, readChunk, reader, chunkName.c_str(), "t");
+    delete reader;
+    file.close();
+    
+    if (status == LUA_OK && useCache) {
+        luaStoreCachedChunk(L, scriptPath, key);
+    }
+    return status;
+}
+
+bool luaLoadCachedChunk(lua_State* L, const char* scriptPath, LuaChunkKey key) {
+    std::string path = luaBytecodePath(scriptPath);
+    if (!LittleFS.exists(path.c_str())) return false;
+
+    File file = LittleFS.open(path.c_str(), "r");
+    if (!file) return false;
+
+    LuaChunkHeader header;
+    if (file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header) ||
+        memcmp(header.magic, LUA_CHUNK_MAGIC, sizeof(header.magic)) != 0 ||
+        header.luaVersion != LUA_VERSION_NUM ||
+        header.sourceSize != key.sourceSize ||
+        header.sourceHash != key.sourceHash) {
+        file.close();
+        return false;
+    }
+
+    ChunkReader* reader = new ChunkReader;
+    reader->file = &file;
+    std::string chunkName = std::string("@") + scriptPath;
+    int status = lua_load(L, readChunk, reader, chunkName.c_str(), "b");
+    delete reader;
+    file.close();
+
+    if (status != LUA_OK) {
+        // Stale or foreign bytecode: drop it and let the caller recompile
+        Serial.print(F("Discarding bytecode cache: "));
+        Serial.println(lua_tostring(L, -1));
+        lua_pop(L, 1);
+        LittleFS.remove(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool luaStoreCachedChunk(lua_State* L, const char* scriptPath, LuaChunkKey key) {
+    std::string path = luaBytecodePath(scriptPath);
+    std::string tmpPath = path + ".tmp";
+
+    File file = LittleFS.open(tmpPath.c_str(), "w");
+    if (!file) return false;
+
+    LuaChunkHeader header;
+    memcpy(header.magic, LUA_CHUNK_MAGIC, sizeof(header.magic));
+    header.luaVersion = LUA_VERSION_NUM;
+    header.flags = 0;
+    header.sourceSize = key.sourceSize;
+    header.sourceHash = key.sourceHash;
+
+    bool ok = file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) == sizeof(header) &&
+              lua_dump(L, writeChunk, &file, 0) == 0;
+    file.close();
+
+    // Renaming over the old cache keeps a half-written chunk from ever
+    // being picked up after a reset mid-write.
+    if (!ok || !LittleFS.rename(tmpPath.c_str(), path.c_str())) {
+        LittleFS.remove(tmpPath.c_str());
+        Serial.print(F("Failed to write bytecode cache: "));
+        Serial.println(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void luaInvalidateCachedChunk(const char* scriptPath) {
+    std::string path = luaBytecodePath(scriptPath);
+    if (LittleFS.exists(path.c_str())) {
+        LittleFS.remove(path.c_str());
+    }
+}
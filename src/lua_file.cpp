@@ -0,0 +1,339 @@
+#include "lua_file.h"
+#include "lua_buffer.h"
+#include <LittleFS.h>
+#include <new>
+
+extern "C" {
+#include "lua/lauxlib.h"
+}
+
+#define FILE_BUFFER_EMPTY 0
+#define FILE_BUFFER_READ 1
+#define FILE_BUFFER_WRITE 2
+
+// buf holds either read-ahead (pos..len not yet consumed) or pending
+// writes (0..len), never both
+struct LuaFile {
+    File file;
+    bool open;
+    uint8_t mode;
+    uint16_t pos;
+    uint16_t len;
+    uint8_t buf[LUA_FILE_BUFFER_SIZE];
+};
+
+
+static LuaFile* checkFile(lua_State* L, int index) {
+    LuaFile* f = (LuaFile*)luaL_checkudata(L, index, LUA_FILE_METATABLE);
+    if (!f->open) luaL_error(L, "attempt to use a closed file");
+    return f;
+}
+
+static bool flushWrites(LuaFile* f) {
+    bool ok = true;
+    if (f->mode == FILE_BUFFER_WRITE && f->len > 0) {
+        ok = f->file.write(f->buf, f->len) == f->len;
+    }
+    if (f->mode == FILE_BUFFER_WRITE) {
+        f->mode = FILE_BUFFER_EMPTY;
+        f->len = 0;
+    }
+    return ok;
+}
+
+// Hands unread read-ahead back so the file position is the logical one
+static void dropReadAhead(LuaFile* f) {
+    if (f->mode != FILE_BUFFER_READ) return;
+    uint16_t unread = f->len - f->pos;
+    if (unread > 0) {
+        f->file.seek(f->file.position() - unread);
+    }
+    f->mode = FILE_BUFFER_EMPTY;
+    f->pos = 0;
+    f->len = 0;
+}
+
+static bool settle(LuaFile* f) {
+    dropReadAhead(f);
+    return flushWrites(f);
+}
+
+// Makes sure there is unread data in buf; false at end of file
+static bool fillReadAhead(LuaFile* f) {
+    if (f->mode == FILE_BUFFER_READ && f->pos < f->len) return true;
+    flushWrites(f);
+    int n = f->file.read(f->buf, sizeof(f->buf));
+    f->mode = FILE_BUFFER_READ;
+    f->pos = 0;
+    f->len = n > 0 ? n : 0;
+    return f->len > 0;
+}
+
+// Pushes the next line without its '\n' (or "\r\n"). A line that lies in
+// the read-ahead goes straight from it into the Lua string; only lines
+// crossing a refill are assembled in a luaL_Buffer.
+static bool pushLine(lua_State* L, LuaFile* f) {
+    if (!fillReadAhead(f)) return false;
+    
+    const uint8_t* start = f->buf + f->pos;
+    const uint8_t* nl = (const uint8_t*)memchr(start, '\n', f->len - f->pos);
+    if (nl) {
+        size_t n = nl - start;
+        f->pos += n + 1;
+        if (n > 0 && start[n - 1] == '\r') n--;
+        lua_pushlstring(L, (const char*)start, n);
+        return true;
+    }
+    
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+    do {
+        start = f->buf + f->pos;
+        nl = (const uint8_t*)memchr(start, '\n', f->len - f->pos);
+        size_t n = nl ? (size_t)(nl - start) : (size_t)(f->len - f->pos);
+        luaL_addlstring(&b, (const char*)start, n);
+        f->pos += nl ? n + 1 : n;
+        if (nl) break;
+    } while (fillReadAhead(f));
+    
+    if (luaL_bufflen(&b) > 0 && luaL_buffaddr(&b)[luaL_bufflen(&b) - 1] == '\r') {
+        luaL_buffsub(&b, 1);
+    }
+    luaL_pushresult(&b);
+    return true;
+}
+
+// Copies up to n bytes to dst, read-ahead first, the rest straight from
+// the file
+static size_t readBytes(LuaFile* f, uint8_t* dst, size_t n) {
+    size_t done = 0;
+    if (f->mode == FILE_BUFFER_READ && f->pos < f->len) {
+        done = f->len - f->pos;
+        if (done > n) done = n;
+        memcpy(dst, f->buf + f->pos, done);
+        f->pos += done;
+    }
+    if (done < n) {
+        flushWrites(f);
+        int got = f->file.read(dst + done, n - done);
+        if (got > 0) done += got;
+    }
+    return done;
+}
+
+
+static int lua_filesystem_open(lua_State* L) {
+    const char* path = luaL_checkstring(L, 1);
+    const char* mode = luaL_optstring(L, 2, "r");
+    
+    // The handle first: if the allocation raises, no file is open yet to leak
+    LuaFile* f = (LuaFile*)lua_newuserdatauv(L, sizeof(LuaFile), 0);
+    new (f) LuaFile();
+    f->open = false;
+    f->mode = FILE_BUFFER_EMPTY;
+    f->pos = 0;
+    f->len = 0;
+    luaL_setmetatable(L, LUA_FILE_METATABLE);
+    
+    f->file = LittleFS.open(path, mode);
+    if (!f->file) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "cannot open %s", path);
+        return 2;
+    }
+    f->open = true;
+    return 1;
+}
+
+static int lua_filesystem_exists(lua_State* L) {
+    const char* path = luaL_checkstring(L, 1);
+    lua_pushboolean(L, LittleFS.exists(path));
+    return 1;
+}
+
+// file:read([n]) - n bytes (nil at end of file), or the rest of the file
+static int lua_file_read(lua_State* L) {
+    LuaFile* f = checkFile(L, 1);
+    
+    if (!lua_isnoneornil(L, 2)) {
+        lua_Integer n = luaL_checkinteger(L, 2);
+        luaL_argcheck(L, n >= 0, 2, "negative count");
+        luaL_Buffer b;
+        uint8_t* dst = (uint8_t*)luaL_buffinitsize(L, &b, n);
+        size_t got = readBytes(f, dst, n);
+        if (got == 0 && n > 0) {
+            lua_pushnil(L);
+            return 1;
+        }
+        luaL_pushresultsize(&b, got);
+        return 1;
+    }
+    
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+    while (fillReadAhead(f)) {
+        luaL_addlstring(&b, (const char*)f->buf + f->pos, f->len - f->pos);
+        f->pos = f->len;
+    }
+    luaL_pushresult(&b);
+    return 1;
+}
+
+static int lua_file_readLine(lua_State* L) {
+    LuaFile* f = checkFile(L, 1);
+    if (!pushLine(L, f)) lua_pushnil(L);
+    return 1;
+}
+
+static int linesIterator(lua_State* L) {
+    LuaFile* f = checkFile(L, lua_upvalueindex(1));
+    if (!pushLine(L, f)) lua_pushnil(L);
+    return 1;
+}
+
+// for line in file:lines() do ... end
+static int lua_file_lines(lua_State* L) {
+    checkFile(L, 1);
+    lua_pushvalue(L, 1);
+    lua_pushcclosure(L, linesIterator, 1);
+    return 1;
+}
+
+// file:readInto(buf) - fills buf from the current position, returns bytes read
+static int lua_file_readInto(lua_State* L) {
+    LuaFile* f = checkFile(L, 1);
+    LuaBuffer* buffer = luaBufferCheck(L, 2);
+    lua_pushinteger(L, readBytes(f, buffer->data, buffer->bytes));
+    return 1;
+}
+
+// file:write(data) - a string or a buffer, returns bytes written
+static int lua_file_write(lua_State* L) {
+    LuaFile* f = checkFile(L, 1);
+    const uint8_t* data;
+    size_t len;
+    LuaBuffer* buffer = luaBufferTest(L, 2);
+    if (buffer) {
+        data = buffer->data;
+        len = buffer->bytes;
+    } else {
+        data = reinterpret_cast<const uint8_t*>(luaL_checklstring(L, 2, &len));
+    }
+    
+    dropReadAhead(f);
+    if (f->len + len > sizeof(f->buf) && !flushWrites(f)) {
+        lua_pushnil(L);
+        return 1;
+    }
+    
+    if (len >= sizeof(f->buf)) {
+        lua_pushinteger(L, f->file.write(data, len));
+        return 1;
+    }
+    memcpy(f->buf + f->len, data, len);
+    f->len += len;
+    f->mode = FILE_BUFFER_WRITE;
+    lua_pushinteger(L, len);
+    return 1;
+}
+
+// file:seek([pos[, whence]]) - whence is "set", "cur" or "end"; returns
+// the new position
+static int lua_file_seek(lua_State* L) {
+    static const char* const whenceNames[] = { "set", "cur", "end", NULL };
+    static const SeekMode whenceModes[] = { SeekSet, SeekCur, SeekEnd };
+    LuaFile* f = checkFile(L, 1);
+    
+    settle(f);
+    if (!lua_isnoneornil(L, 2)) {
+        lua_Integer pos = luaL_checkinteger(L, 2);
+        int whence = luaL_checkoption(L, 3, "set", whenceNames);
+        if (!f->file.seek(pos, whenceModes[whence])) {
+            lua_pushnil(L);
+            return 1;
+        }
+    }
+    lua_pushinteger(L, f->file.position());
+    return 1;
+}
+
+static int lua_file_size(lua_State* L) {
+    LuaFile* f = checkFile(L, 1);
+    flushWrites(f);
+    lua_pushinteger(L, f->file.size());
+    return 1;
+}
+
+static int lua_file_flush(lua_State* L) {
+    LuaFile* f = checkFile(L, 1);
+    bool ok = flushWrites(f);
+    f->file.flush();
+    lua_pushboolean(L, ok);
+    return 1;
+}
+
+static void closeFile(LuaFile* f) {
+    if (!f->open) return;
+    flushWrites(f);
+    f->file.close();
+    f->open = false;
+}
+
+static int lua_file_close(lua_State* L) {
+    LuaFile* f = (LuaFile*)luaL_checkudata(L, 1, LUA_FILE_METATABLE);
+    bool wasOpen = f->open;
+    closeFile(f);
+    lua_pushboolean(L, wasOpen);
+    return 1;
+}
+
+static int lua_file_gc(lua_State* L) {
+    LuaFile* f = (LuaFile*)luaL_checkudata(L, 1, LUA_FILE_METATABLE);
+    closeFile(f);
+    f->~LuaFile();
+    return 0;
+}
+
+static int lua_file_tostring(lua_State* L) {
+    LuaFile* f = (LuaFile*)luaL_checkudata(L, 1, LUA_FILE_METATABLE);
+    if (f->open) {
+        lua_pushfstring(L, "File (%s)", f->file.path());
+    } else {
+        lua_pushliteral(L, "File (closed)");
+    }
+    return 1;
+}
+
+int luaopen_filesystem(lua_State* L) {
+    static const luaL_Reg fileMethods[] = {
+        {"read", lua_file_read},
+        {"readLine", lua_file_readLine},
+        {"lines", lua_file_lines},
+        {"readInto", lua_file_readInto},
+        {"write", lua_file_write},
+        {"seek", lua_file_seek},
+        {"size", lua_file_size},
+        {"flush", lua_file_flush},
+        {"close", lua_file_close},
+        {NULL, NULL}
+    };
+    if (luaL_newmetatable(L, LUA_FILE_METATABLE)) {
+        luaL_newlib(L, fileMethods);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, lua_file_gc);
+        lua_setfield(L, -2, "__gc");
+        lua_pushcfunction(L, lua_file_close);
+        lua_setfield(L, -2, "__close");
+        lua_pushcfunction(L, lua_file_tostring);
+        lua_setfield(L, -2, "__tostring");
+    }
+    lua_pop(L, 1);
+    
+    static const luaL_Reg filesystemLib[] = {
+        {"open", lua_filesystem_open},
+        {"exists", lua_filesystem_exists},
+        {NULL, NULL}
+    };
+    luaL_newlib(L, filesystemLib);
+    return 1;
+}
@@ -1,4 +1,5 @@
 #include "lua_fs.h"
+#include "lua_bytecode.h"
 #include <LittleFS.h>
 #include <map>
 #include <algorithm>
@@ -83,6 +84,7 @@ bool saveScript(const char* path, const char* content) {
     
     size_t written = file.print(content);
     file.close();
+    luaInvalidateCachedChunk(path);
     
     Serial.print(F("Saved script: "));
     Serial.print(path);
@@ -94,6 +96,7 @@ bool saveScript(const char* path, const char* content) {
 }
 
 bool deleteScript(const char* path) {
+    luaInvalidateCachedChunk(path);
     if (LittleFS.remove(path)) {
         Serial.print(F("Deleted script: "));
         Serial.println(path);
@@ -129,13 +132,45 @@ std::string getScriptDataFolder(const char* scriptPath) {
     return "";
 }
 
-std::string readDataFile(const char* scriptPath, const char* filename) {
+std::string getDataFilePath(const char* scriptPath, const char* filename, bool create) {
     std::string dataFolder = getScriptDataFolder(scriptPath);
     if (dataFolder.length() == 0) {
+        if (!create) return "";
+        
+        std::string path = scriptPath;
+        size_t dotPos = path.rfind('.');
+        if (dotPos != std::string::npos && dotPos > 0) {
+            path = path.substr(0, dotPos);
+        }
+        LittleFS.mkdir(path.c_str());
+        dataFolder = path + "/";
+    }
+    return dataFolder + filename;
+}
+
+File beginAtomicWrite(const char* path) {
+    std::string tmpPath = std::string(path) + ".tmp";
+    return LittleFS.open(tmpPath.c_str(), "w");
+}
+
+bool finishAtomicWrite(File& file, const char* path, bool commit) {
+    std::string tmpPath = std::string(path) + ".tmp";
+    if (file) file.close();
+    
+    // LittleFS renames over an existing file in one step
+    if (commit && LittleFS.rename(tmpPath.c_str(), path)) {
+        return true;
+    }
+    LittleFS.remove(tmpPath.c_str());
+    return false;
+}
+
+std::string readDataFile(const char* scriptPath, const char* filename) {
+    std::string filePath = getDataFilePath(scriptPath, filename, false);
+    if (filePath.length() == 0) {
         return "";
     }
     
-    std::string filePath = dataFolder + filename;
     File file = LittleFS.open(filePath.c_str(), "r");
     if (!file) {
         return "";
@@ -154,27 +189,15 @@ std::string readDataFile(const char* scriptPath, const char* filename) {
 }
 
 bool writeDataFile(const char* scriptPath, const char* filename, const char* content) {
-    std::string dataFolder = getScriptDataFolder(scriptPath);
-    if (dataFolder.length() == 0) {
-        
-        std::string path = scriptPath;
-        size_t dotPos = path.rfind('.');
-        if (dotPos != std::string::npos && dotPos > 0) {
-            path = path.substr(0, dotPos);
-        }
-        LittleFS.mkdir(path.c_str());
-        dataFolder = path + "/";
-    }
-    
-    std::string filePath = dataFolder + filename;
-    File file = LittleFS.open(filePath.c_str(), "w");
+    std::string filePath = getDataFilePath(scriptPath, filename, true);
+    File file = beginAtomicWrite(filePath.c_str());
     if (!file) {
         return false;
     }
     
+    size_t length = strlen(content);
     size_t written = file.print(content);
-    file.close();
-    return written > 0;
+    return finishAtomicWrite(file, filePath.c_str(), written == length) && written > 0;
 }
 
 size_t getFSFreeSpace() {
@@ -0,0 +1,279 @@
+#include "lua_grid.h"
+#include <FlipperDisplay.h>
+#include <string.h>
+
+extern "C" {
+#include "lua/lauxlib.h"
+}
+
+// g:draw() styles, indexed by cell value
+enum GridStyle { GRID_NONE, GRID_FILL, GRID_BLOCK, GRID_RECT, GRID_DOT };
+static const char* const styleNames[] = { "none", "fill", "block", "rect", "dot", NULL };
+
+
+static inline uint32_t cellMask(const LuaGrid* grid) {
+    return (1u << grid->bits) - 1;
+}
+
+static inline uint32_t readCell(const LuaGrid* grid, uint32_t i) {
+    uint32_t bit = i * grid->bits;
+    return (grid->cells[bit >> 3] >> (bit & 7)) & cellMask(grid);
+}
+
+static inline void writeCell(LuaGrid* grid, uint32_t i, uint32_t value) {
+    uint32_t bit = i * grid->bits;
+    uint8_t mask = cellMask(grid) << (bit & 7);
+    uint8_t* p = &grid->cells[bit >> 3];
+    *p = (*p & ~mask) | ((value << (bit & 7)) & mask);
+}
+
+static inline uint32_t gridBytes(uint32_t cells, uint8_t bits) {
+    return (cells * bits + 7) / 8;
+}
+
+static LuaGrid* checkGrid(lua_State* L, int index) {
+    return (LuaGrid*)luaL_checkudata(L, index, LUA_GRID_METATABLE);
+}
+
+static uint32_t checkValue(lua_State* L, int index, const LuaGrid* grid, lua_Integer def) {
+    lua_Integer value = luaL_optinteger(L, index, def);
+    luaL_argcheck(L, value >= 0 && (uint32_t)value <= cellMask(grid), index, "value does not fit the cell");
+    return (uint32_t)value;
+}
+
+// Cell index for (x, y), or -1 outside the grid
+static int32_t cellIndex(const LuaGrid* grid, lua_Integer x, lua_Integer y) {
+    if (x < 0 || y < 0 || x >= grid->width || y >= grid->height) return -1;
+    return (int32_t)(y * grid->width + x);
+}
+
+
+// grid.new(w, h, [bits]) - all cells 0
+static int lua_grid_new(lua_State* L) {
+    lua_Integer w = luaL_checkinteger(L, 1);
+    lua_Integer h = luaL_checkinteger(L, 2);
+    lua_Integer bits = luaL_optinteger(L, 3, 1);
+    // width and height are stored as uint16_t
+    luaL_argcheck(L, w > 0 && h > 0 && w <= 0xFFFF && h <= 0xFFFF && w * h <= LUA_GRID_MAX_CELLS,
+                  1, "grid size out of range");
+    luaL_argcheck(L, bits == 1 || bits == 2 || bits == 4 || bits == 8, 3, "bits must be 1, 2, 4 or 8");
+
+    uint32_t bytes = gridBytes((uint32_t)(w * h), (uint8_t)bits);
+    LuaGrid* grid = (LuaGrid*)lua_newuserdatauv(L, sizeof(LuaGrid) + bytes, 0);
+    grid->width = (uint16_t)w;
+    grid->height = (uint16_t)h;
+    grid->bits = (uint8_t)bits;
+    grid->cells = reinterpret_cast<uint8_t*>(grid + 1);
+    memset(grid->cells, 0, bytes);
+    luaL_setmetatable(L, LUA_GRID_METATABLE);
+    return 1;
+}
+
+// g:get(x, y) - nil outside the grid, so walls need no separate check
+static int lua_grid_get(lua_State* L) {
+    LuaGrid* grid = checkGrid(L, 1);
+    int32_t i = cellIndex(grid, luaL_checkinteger(L, 2), luaL_checkinteger(L, 3));
+    if (i < 0) {
+        lua_pushnil(L);
+    } else {
+        lua_pushinteger(L, readCell(grid, i));
+    }
+    return 1;
+}
+
+// g:set(x, y, [value]) - returns the previous value
+static int lua_grid_set(lua_State* L) {
+    LuaGrid* grid = checkGrid(L, 1);
+    int32_t i = cellIndex(grid, luaL_checkinteger(L, 2), luaL_checkinteger(L, 3));
+    uint32_t value = checkValue(L, 4, grid, 1);
+    if (i < 0) {
+        return luaL_error(L, "cell out of range");
+    }
+    lua_pushinteger(L, readCell(grid, i));
+    writeCell(grid, i, value);
+    return 1;
+}
+
+// g:fill(value, [x, y, w, h]) - the region is clipped to the grid
+static int lua_grid_fill(lua_State* L) {
+    LuaGrid* grid = checkGrid(L, 1);
+    uint32_t value = checkValue(L, 2, grid, 0);
+
+    if (lua_isnoneornil(L, 3)) {
+        uint8_t pattern = 0;
+        for (int shift = 0; shift < 8; shift += grid->bits) {
+            pattern |= value << shift;
+        }
+        memset(grid->cells, pattern, gridBytes((uint32_t)grid->width * grid->height, grid->bits));
+        return 0;
+    }
+
+    lua_Integer x0 = luaL_checkinteger(L, 3);
+    lua_Integer y0 = luaL_checkinteger(L, 4);
+    lua_Integer x1 = x0 + luaL_checkinteger(L, 5);
+    lua_Integer y1 = y0 + luaL_checkinteger(L, 6);
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > grid->width) x1 = grid->width;
+    if (y1 > grid->height) y1 = grid->height;
+    for (lua_Integer y = y0; y < y1; y++) {
+        for (lua_Integer x = x0; x < x1; x++) {
+            writeCell(grid, (uint32_t)(y * grid->width + x), value);
+        }
+    }
+    return 0;
+}
+
+// g:count([value]) - cells holding value, or all non-zero cells
+static int lua_grid_count(lua_State* L) {
+    LuaGrid* grid = checkGrid(L, 1);
+    bool any = lua_isnoneornil(L, 2);
+    uint32_t value = any ? 0 : checkValue(L, 2, grid, 0);
+    uint32_t cells = (uint32_t)grid->width * grid->height;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < cells; i++) {
+        uint32_t cell = readCell(grid, i);
+        if (any ? cell != 0 : cell == value) count++;
+    }
+    lua_pushinteger(L, count);
+    return 1;
+}
+
+// g:randomFree([value]) - x, y of a uniformly chosen cell holding value
+// (default 0), or nil when there is none
+static int lua_grid_randomFree(lua_State* L) {
+    LuaGrid* grid = checkGrid(L, 1);
+    uint32_t value = checkValue(L, 2, grid, 0);
+    uint32_t cells = (uint32_t)grid->width * grid->height;
+
+    uint32_t matches = 0;
+    for (uint32_t i = 0; i < cells; i++) {
+        if (readCell(grid, i) == value) matches++;
+    }
+    if (matches == 0) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    uint32_t pick = (uint32_t)random(matches);
+    for (uint32_t i = 0; i < cells; i++) {
+        if (readCell(grid, i) == value && pick-- == 0) {
+            lua_pushinteger(L, i % grid->width);
+            lua_pushinteger(L, i / grid->width);
+            return 2;
+        }
+    }
+    return 0;
+}
+
+// g:size() - w, h
+static int lua_grid_size(lua_State* L) {
+    LuaGrid* grid = checkGrid(L, 1);
+    lua_pushinteger(L, grid->width);
+    lua_pushinteger(L, grid->height);
+    return 2;
+}
+
+static void drawCell(FlipperDisplay* display, uint8_t style, int x, int y, int size) {
+    switch (style) {
+        case GRID_FILL: {
+            int side = size > 1 ? size - 1 : 1;
+            display->fillRect(x, y, side, side, COLOR_WHITE);
+            break;
+        }
+        case GRID_BLOCK:
+            display->fillRect(x, y, size, size, COLOR_WHITE);
+            break;
+        case GRID_RECT: {
+            int side = size > 1 ? size - 1 : 1;
+            display->fillRect(x, y, side, 1, COLOR_WHITE);
+            display->fillRect(x, y + side - 1, side, 1, COLOR_WHITE);
+            display->fillRect(x, y, 1, side, COLOR_WHITE);
+            display->fillRect(x + side - 1, y, 1, side, COLOR_WHITE);
+            break;
+        }
+        case GRID_DOT: {
+            int inset = size / 4;
+            int side = size - 2 * inset - 1;
+            if (side < 1) side = 1;
+            display->fillRect(x + inset, y + inset, side, side, COLOR_WHITE);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// g:draw(x, y, size, [styles]) - each cell as a size x size tile at
+// (x, y) + cell * size. styles maps cell values to "fill" (tile with a
+// 1 px gap), "block", "rect", "dot" or "none"; without it every non-zero
+// cell is drawn as "fill".
+static int lua_grid_draw(lua_State* L) {
+    extern FlipperDisplay* display;
+    LuaGrid* grid = checkGrid(L, 1);
+    int x0 = luaL_checkinteger(L, 2);
+    int y0 = luaL_checkinteger(L, 3);
+    int size = luaL_checkinteger(L, 4);
+    luaL_argcheck(L, size > 0, 4, "tile size must be positive");
+
+    uint32_t values = cellMask(grid) + 1;
+    uint8_t styles[256];
+    if (lua_isnoneornil(L, 5)) {
+        memset(styles, GRID_FILL, values);
+        styles[0] = GRID_NONE;
+    } else {
+        luaL_checktype(L, 5, LUA_TTABLE);
+        for (uint32_t v = 0; v < values; v++) {
+            lua_rawgeti(L, 5, v);
+            styles[v] = lua_isnil(L, -1) ? GRID_NONE : luaL_checkoption(L, -1, NULL, styleNames);
+            lua_pop(L, 1);
+        }
+    }
+    if (!display) return 0;
+
+    uint32_t i = 0;
+    for (int cy = 0; cy < grid->height; cy++) {
+        for (int cx = 0; cx < grid->width; cx++, i++) {
+            uint8_t style = styles[readCell(grid, i)];
+            if (style != GRID_NONE) {
+                drawCell(display, style, x0 + cx * size, y0 + cy * size, size);
+            }
+        }
+    }
+    return 0;
+}
+
+static int lua_grid_tostring(lua_State* L) {
+    LuaGrid* grid = checkGrid(L, 1);
+    lua_pushfstring(L, "Grid(%dx%d, %d bit)", (int)grid->width, (int)grid->height, (int)grid->bits);
+    return 1;
+}
+
+
+int luaopen_grid(lua_State* L) {
+    static const luaL_Reg gridMethods[] = {
+        {"get", lua_grid_get},
+        {"set", lua_grid_set},
+        {"fill", lua_grid_fill},
+        {"count", lua_grid_count},
+        {"randomFree", lua_grid_randomFree},
+        {"size", lua_grid_size},
+        {"draw", lua_grid_draw},
+        {NULL, NULL}
+    };
+    static const luaL_Reg gridLib[] = {
+        {"new", lua_grid_new},
+        {NULL, NULL}
+    };
+
+    if (luaL_newmetatable(L, LUA_GRID_METATABLE)) {
+        luaL_newlib(L, gridMethods);
+        lua_setfield(L, -2, "__index");
+        lua_pushcfunction(L, lua_grid_tostring);
+        lua_setfield(L, -2, "__tostring");
+    }
+    lua_pop(L, 1);
+
+    luaL_newlib(L, gridLib);
+    return 1;
+}
@@ -0,0 +1,249 @@
+#include "lua_heap.h"
+#include "config.h"
+#include <esp_heap_caps.h>
+#include <multi_heap.h>
+#include <string.h>
+
+#define LUA_HEAP_ARENA_MIN 8192
+// Room for multi_heap's own bookkeeping when a region is sized for one block
+#define LUA_HEAP_REGION_OVERHEAD 512
+
+struct ArenaRegion {
+    uint8_t* start;
+    size_t size;
+    multi_heap_handle_t heap;
+};
+
+static ArenaRegion regions[LUA_HEAP_ARENA_MAX_REGIONS];
+static int regionCount = 0;
+static LuaHeapStats stats;
+static char ownerName[32] = "";
+
+
+// Region holding ptr, or -1 for a block on the general heap
+static int regionOf(void* ptr) {
+    for (int i = 0; i < regionCount; i++) {
+        if (ptr >= regions[i].start && ptr < regions[i].start + regions[i].size) return i;
+    }
+    return -1;
+}
+
+static bool addRegion(size_t size) {
+    if (regionCount >= LUA_HEAP_ARENA_MAX_REGIONS) return false;
+    uint8_t* start = static_cast<uint8_t*>(heap_caps_malloc(size, MALLOC_CAP_8BIT));
+    if (!start) return false;
+    multi_heap_handle_t heap = multi_heap_register(start, size);
+    if (!heap) {
+        heap_caps_free(start);
+        return false;
+    }
+    regions[regionCount++] = { start, size, heap };
+    stats.arenaBytes += size;
+    return true;
+}
+
+static void* allocBlock(size_t size) {
+    for (int i = 0; i < regionCount; i++) {
+        void* ptr = multi_heap_malloc(regions[i].heap, size);
+        if (ptr) return ptr;
+    }
+
+    // Grow the arena before spilling. Without a first region (no arena
+    // configured or none available) the VM runs on the general heap.
+    if (regionCount > 0) {
+        size_t grow = size + LUA_HEAP_REGION_OVERHEAD;
+        if (grow < LUA_HEAP_ARENA_GROW_SIZE) grow = LUA_HEAP_ARENA_GROW_SIZE;
+        if (addRegion(grow)) {
+            void* ptr = multi_heap_malloc(regions[regionCount - 1].heap, size);
+            if (ptr) return ptr;
+        }
+    }
+
+    // Plain malloc, so app_heap counts the spill against the app
+    void* ptr = malloc(size);
+    if (ptr && regionCount > 0) {
+        stats.spilledAllocs++;
+        stats.spilledBytes += size;
+    }
+    return ptr;
+}
+
+static void freeBlock(void* ptr) {
+    int region = regionOf(ptr);
+    if (region >= 0) {
+        multi_heap_free(regions[region].heap, ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+static void* luaHeapAlloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+    // With ptr == NULL, osize carries the object type, not a size
+    if (!ptr) osize = 0;
+
+    if (nsize == 0) {
+        if (ptr) {
+            freeBlock(ptr);
+            stats.liveBytes -= osize;
+        }
+        return nullptr;
+    }
+
+    // Only growth is capped; Lua assumes shrinking never fails
+    uint32_t appBytes = stats.liveBytes > stats.libraryBytes ? stats.liveBytes - stats.libraryBytes : 0;
+    if (stats.cap > 0 && nsize > osize && appBytes + (nsize - osize) > stats.cap) {
+        stats.failedAllocs++;
+        return nullptr;
+    }
+
+    void* result;
+    int region = ptr ? regionOf(ptr) : -1;
+    if (!ptr) {
+        result = allocBlock(nsize);
+    } else if (region >= 0) {
+        result = multi_heap_realloc(regions[region].heap, ptr, nsize);
+        if (!result && nsize > osize) {
+            result = allocBlock(nsize);
+            if (result) {
+                memcpy(result, ptr, osize);
+                multi_heap_free(regions[region].heap, ptr);
+            }
+        }
+    } else {
+        result = realloc(ptr, nsize);
+        if (result && regionCount > 0 && nsize > osize) {
+            stats.spilledBytes += nsize - osize;
+        }
+    }
+
+    if (!result) {
+        stats.failedAllocs++;
+        return nullptr;
+    }
+
+    stats.liveBytes += nsize - osize;
+    if (stats.liveBytes > stats.peakBytes) {
+        stats.peakBytes = stats.liveBytes;
+    }
+    return result;
+}
+
+static int luaHeapPanic(lua_State* L) {
+    const char* msg = lua_tostring(L, -1);
+    Serial.print(F("Lua panic: "));
+    Serial.println(msg ? msg : "(non-string error)");
+    return 0;
+}
+
+static void updateArenaInfo() {
+    stats.totalFree = 0;
+    stats.largestFree = 0;
+    stats.regions = regionCount;
+    for (int i = 0; i < regionCount; i++) {
+        multi_heap_info_t info;
+        multi_heap_get_info(regions[i].heap, &info);
+        stats.totalFree += info.total_free_bytes;
+        if (info.largest_free_block > stats.largestFree) {
+            stats.largestFree = info.largest_free_block;
+        }
+    }
+    stats.fragmentationPct = stats.totalFree > 0
+        ? 100 - (uint32_t)((uint64_t)stats.largestFree * 100 / stats.totalFree)
+        : 0;
+}
+
+
+lua_State* luaHeapNewState(const char* appName) {
+    memset(&stats, 0, sizeof(stats));
+    strncpy(ownerName, appName ? appName : "", sizeof(ownerName) - 1);
+    ownerName[sizeof(ownerName) - 1] = '\0';
+    stats.cap = LUA_HEAP_CAP;
+
+    // Take the largest first region we can get, down to
+    // LUA_HEAP_ARENA_MIN; without one the VM simply runs on the general
+    // heap. Further regions are added on demand by allocBlock().
+    for (size_t size = LUA_HEAP_ARENA_SIZE; size >= LUA_HEAP_ARENA_MIN; size /= 2) {
+        if (addRegion(size)) break;
+    }
+    if (regionCount == 0 && LUA_HEAP_ARENA_SIZE > 0) {
+        Serial.println(F("Lua heap: no arena available, using general heap"));
+    }
+
+    lua_State* L = lua_newstate(luaHeapAlloc, nullptr);
+    if (L) {
+        lua_atpanic(L, luaHeapPanic);
+    }
+    return L;
+}
+
+static void printReport(const LuaHeapStats& result) {
+    Serial.printf("[LUA HEAP] %s: peak %u bytes, %u-byte arena in %u region(s), fragmentation %u%%, %u spilled (%u bytes), %u failed",
+                  ownerName,
+                  (unsigned)result.peakBytes,
+                  (unsigned)result.arenaBytes,
+                  (unsigned)result.regions,
+                  (unsigned)result.fragmentationPct,
+                  (unsigned)result.spilledAllocs,
+                  (unsigned)result.spilledBytes,
+                  (unsigned)result.failedAllocs);
+    if (result.cap > 0) {
+        Serial.printf(" (cap %u)", (unsigned)result.cap);
+    }
+    if (result.libraryBytes > 0) {
+        Serial.printf(", %u bytes in libraries", (unsigned)result.libraryBytes);
+    }
+}
+
+void luaHeapBeginApp(const char* appName) {
+    strncpy(ownerName, appName ? appName : "", sizeof(ownerName) - 1);
+    ownerName[sizeof(ownerName) - 1] = '\0';
+    stats.peakBytes = stats.liveBytes;
+    stats.spilledAllocs = 0;
+    stats.spilledBytes = 0;
+    stats.failedAllocs = 0;
+}
+
+LuaHeapStats luaHeapReport() {
+    updateArenaInfo();
+    printReport(stats);
+    Serial.println();
+    return stats;
+}
+
+void luaHeapReportSpills() {
+    Serial.printf("[HEAP] %s: Lua VM spilled %u allocs (%u bytes) past its %u-byte arena\n",
+                  ownerName,
+                  (unsigned)stats.spilledAllocs,
+                  (unsigned)stats.spilledBytes,
+                  (unsigned)stats.arenaBytes);
+}
+
+LuaHeapStats luaHeapCloseState(lua_State* L, bool report) {
+    updateArenaInfo();
+    LuaHeapStats result = stats;
+
+    if (L) lua_close(L);
+
+    if (report) {
+        printReport(result);
+        if (stats.liveBytes != 0) {
+            Serial.printf(" | %u bytes still live after close", (unsigned)stats.liveBytes);
+        }
+        Serial.println();
+    }
+
+    for (int i = 0; i < regionCount; i++) {
+        heap_caps_free(regions[i].start);
+    }
+    regionCount = 0;
+    return result;
+}
+
+LuaHeapStats luaHeapStats() {
+    updateArenaInfo();
+    return stats;
+}
+
+void luaHeapAddLibraryBytes(uint32_t bytes) {
+    stats.libraryBytes += bytes;
+}
@@ -0,0 +1,268 @@
+#include "lua_profiler.h"
+#include "config.h"
+#include <LittleFS.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "lua/lauxlib.h"
+}
+
+#define PROFILER_HOOK_COUNT 100
+#define PROFILER_MAX_DEPTH 16
+#define PROFILER_TOP_COUNT 10
+#define PROFILER_DIR "/storage/profiles"
+
+struct NativeStat {
+    std::string name;
+    uint32_t calls;
+    uint32_t samples;
+};
+
+static esp_timer_handle_t sampleTimer = nullptr;
+static volatile uint32_t tickCount = 0;
+static uint32_t attributedTicks = 0;
+static uint32_t outsideSamples = 0;
+static uint32_t luaSamples = 0;
+static bool active = false;
+static std::string profileName;
+static std::map<std::string, uint32_t> stacks;
+static std::map<lua_CFunction, NativeStat> natives;
+
+
+static void onSampleTimer(void*) {
+    tickCount++;
+}
+
+static const char* baseName(const char* path) {
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// "module.field" for a function found in package.loaded, else the name
+// the caller used, else "?"
+static std::string findNativeName(lua_State* L, lua_CFunction fn, const char* callName) {
+    std::string found;
+    luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+    lua_pushnil(L);
+    while (found.empty() && lua_next(L, -2)) {
+        if (lua_type(L, -2) == LUA_TSTRING && lua_istable(L, -1)) {
+            lua_pushnil(L);
+            while (lua_next(L, -2)) {
+                if (lua_type(L, -2) == LUA_TSTRING && lua_tocfunction(L, -1) == fn) {
+                    const char* module = lua_tostring(L, -4);
+                    found = strcmp(module, LUA_GNAME) == 0 ? "" : std::string(module) + ".";
+                    found += lua_tostring(L, -2);
+                    lua_pop(L, 2);
+                    break;
+                }
+                lua_pop(L, 1);
+            }
+        }
+        lua_pop(L, 1);
+    }
+    if (!found.empty()) lua_pop(L, 1);  // lua_next left the module key
+    lua_pop(L, 1);
+    
+    if (found.empty()) found = callName ? callName : "?";
+    return found;
+}
+
+static NativeStat& nativeStat(lua_State* L, lua_CFunction fn, const char* callName) {
+    std::map<lua_CFunction, NativeStat>::iterator it = natives.find(fn);
+    if (it == natives.end()) {
+        NativeStat stat;
+        stat.name = findNativeName(L, fn, callName);
+        stat.calls = 0;
+        stat.samples = 0;
+        it = natives.insert(std::make_pair(fn, stat)).first;
+    }
+    return it->second;
+}
+
+// Folded stack from the outermost frame down to firstLevel. Lua frames
+// read "name@file:line": the line being run for the innermost Lua frame,
+// the line the function starts at for the rest.
+static void attribute(lua_State* L, int firstLevel, uint32_t samples) {
+    lua_Debug frames[PROFILER_MAX_DEPTH];
+    int depth = 0;
+    while (depth < PROFILER_MAX_DEPTH && lua_getstack(L, firstLevel + depth, &frames[depth])) {
+        depth++;
+    }
+    
+    std::string key;
+    bool innermostLua = true;
+    std::vector<std::string> names(depth);
+    for (int i = 0; i < depth; i++) {
+        lua_Debug& ar = frames[i];
+        lua_getinfo(L, "Snlf", &ar);
+        if (*ar.what == 'C') {
+            names[i] = nativeStat(L, lua_tocfunction(L, -1), ar.name).name;
+        } else {
+            char frame[96];
+            const char* name = *ar.what == 'm' ? "main" : (ar.name ? ar.name : "?");
+            snprintf(frame, sizeof(frame), "%s@%s:%d", name, baseName(ar.short_src),
+                     innermostLua ? ar.currentline : ar.linedefined);
+            names[i] = frame;
+            innermostLua = false;
+        }
+        lua_pop(L, 1);
+    }
+    
+    for (int i = depth - 1; i >= 0; i--) {
+        key += names[i];
+        if (i > 0) key += ';';
+    }
+    if (key.empty()) key = "?";
+    
+    stacks[key] += samples;
+    luaSamples += samples;
+}
+
+static void profilerHook(lua_State* L, lua_Debug* ar) {
+    uint32_t now = tickCount;
+    uint32_t pending = now - attributedTicks;
+    
+    if (ar->event == LUA_HOOKCOUNT) {
+        if (pending) {
+            attributedTicks = now;
+            attribute(L, 0, pending);
+        }
+        return;
+    }
+    
+    lua_getinfo(L, "S", ar);
+    if (*ar->what != 'C') return;
+    
+    if (ar->event == LUA_HOOKRET) {
+        lua_getinfo(L, "nf", ar);
+        NativeStat& stat = nativeStat(L, lua_tocfunction(L, -1), ar->name);
+        lua_pop(L, 1);
+        stat.calls++;
+        if (pending) {
+            attributedTicks = now;
+            stat.samples += pending;
+            attribute(L, 0, pending);
+        }
+    } else if (pending) {
+        // Entering a binding: what passed so far belongs to its caller
+        attributedTicks = now;
+        attribute(L, 1, pending);
+    }
+}
+
+static void writeFolded(const char* path) {
+    if (!LittleFS.exists(PROFILER_DIR)) {
+        LittleFS.mkdir(PROFILER_DIR);
+    }
+    File file = LittleFS.open(path, "w");
+    if (!file) {
+        Serial.printf("[PROF] could not write %s\n", path);
+        return;
+    }
+    for (std::map<std::string, uint32_t>::const_iterator it = stacks.begin(); it != stacks.end(); ++it) {
+        file.printf("%s %u\n", it->first.c_str(), (unsigned)it->second);
+    }
+    file.close();
+    Serial.printf("[PROF] folded stacks written to %s\n", path);
+}
+
+static bool bySamples(const std::pair<std::string, uint32_t>& a, const std::pair<std::string, uint32_t>& b) {
+    return a.second > b.second;
+}
+
+static void printSummary() {
+    uint32_t total = luaSamples + outsideSamples;
+    Serial.printf("[PROF] %s: %u samples of %u us, %u in Lua, %u outside\n",
+                  profileName.c_str(), (unsigned)total, (unsigned)LUA_PROFILER_PERIOD_US,
+                  (unsigned)luaSamples, (unsigned)outsideSamples);
+    if (luaSamples == 0) return;
+    
+    // Self time: the innermost frame of each stack
+    std::map<std::string, uint32_t> self;
+    for (std::map<std::string, uint32_t>::const_iterator it = stacks.begin(); it != stacks.end(); ++it) {
+        size_t split = it->first.rfind(';');
+        self[split == std::string::npos ? it->first : it->first.substr(split + 1)] += it->second;
+    }
+    std::vector<std::pair<std::string, uint32_t> > top(self.begin(), self.end());
+    std::sort(top.begin(), top.end(), bySamples);
+    
+    Serial.println(F("[PROF] self time:"));
+    for (size_t i = 0; i < top.size() && i < PROFILER_TOP_COUNT; i++) {
+        Serial.printf("  %5.1f%%  %s\n", top[i].second * 100.0f / luaSamples, top[i].first.c_str());
+    }
+    
+    std::vector<std::pair<std::string, uint32_t> > bindings;
+    for (std::map<lua_CFunction, NativeStat>::const_iterator it = natives.begin(); it != natives.end(); ++it) {
+        bindings.push_back(std::make_pair(it->second.name, it->second.samples));
+    }
+    std::sort(bindings.begin(), bindings.end(), bySamples);
+    
+    Serial.println(F("[PROF] native bindings:"));
+    for (size_t i = 0; i < bindings.size() && i < PROFILER_TOP_COUNT; i++) {
+        uint32_t calls = 0;
+        for (std::map<lua_CFunction, NativeStat>::const_iterator it = natives.begin(); it != natives.end(); ++it) {
+            if (it->second.name == bindings[i].first) calls += it->second.calls;
+        }
+        Serial.printf("  %5.1f%%  %s (%u calls)\n", bindings[i].second * 100.0f / luaSamples,
+                      bindings[i].first.c_str(), (unsigned)calls);
+    }
+}
+
+
+bool luaProfilerStart(lua_State* L, const char* appName) {
+    if (!sampleTimer) {
+        esp_timer_create_args_t args = {};
+        args.callback = onSampleTimer;
+        args.name = "lua_prof";
+        if (esp_timer_create(&args, &sampleTimer) != ESP_OK) {
+            sampleTimer = nullptr;
+            Serial.println(F("[PROF] no timer, profiler disabled"));
+            return false;
+        }
+    }
+    
+    stacks.clear();
+    natives.clear();
+    profileName = appName ? appName : "lua";
+    luaSamples = 0;
+    outsideSamples = 0;
+    tickCount = 0;
+    attributedTicks = 0;
+    
+    esp_timer_start_periodic(sampleTimer, LUA_PROFILER_PERIOD_US);
+    lua_sethook(L, profilerHook, LUA_MASKCOUNT | LUA_MASKCALL | LUA_MASKRET, PROFILER_HOOK_COUNT);
+    active = true;
+    Serial.printf("[PROF] profiling %s\n", profileName.c_str());
+    return true;
+}
+
+void luaProfilerSync() {
+    if (!active) return;
+    uint32_t now = tickCount;
+    outsideSamples += now - attributedTicks;
+    attributedTicks = now;
+}
+
+void luaProfilerStop(lua_State* L, lua_State* thread) {
+    if (!active) return;
+    active = false;
+    esp_timer_stop(sampleTimer);
+    lua_sethook(L, NULL, 0, 0);
+    if (thread) lua_sethook(thread, NULL, 0, 0);
+    luaProfilerSync();
+    
+    printSummary();
+    
+    std::string path = std::string(PROFILER_DIR) + "/" + baseName(profileName.c_str());
+    size_t dot = path.rfind('.');
+    if (dot != std::string::npos && dot > path.rfind('/')) path.erase(dot);
+    path += ".folded";
+    writeFolded(path.c_str());
+    
+    std::map<std::string, uint32_t>().swap(stacks);
+    std::map<lua_CFunction, NativeStat>().swap(natives);
+}
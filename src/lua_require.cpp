@@ -0,0 +1,124 @@
+#include "lua_require.h"
+#include "config.h"
+#include "lua_bytecode.h"
+#include "lua_heap.h"
+#include "lua_vm.h"
+#include <string>
+
+extern "C" {
+#include "lua/lauxlib.h"
+}
+
+#define LUA_MODULE_NAME_MAX 48
+
+// Registry slot of the loaded libraries: { [name] = module }. Created
+// before the snapshot, so luaVmReset() keeps the slot and leaves the
+// table's contents alone.
+static const char librariesKey = 0;
+
+
+// Letters, digits, '_' and '-', with single dots between parts
+static bool validModuleName(const char* name) {
+    size_t len = strlen(name);
+    if (len == 0 || len > LUA_MODULE_NAME_MAX) return false;
+    if (name[0] == '.' || name[len - 1] == '.' || strstr(name, "..")) return false;
+    for (size_t i = 0; i < len; i++) {
+        char c = name[i];
+        if (!isalnum((unsigned char)c) && c != '_' && c != '-' && c != '.') return false;
+    }
+    return true;
+}
+
+static std::string modulePath(const char* name) {
+    std::string path = LUA_LIB_DIR "/";
+    for (const char* c = name; *c; c++) {
+        path += *c == '.' ? '/' : *c;
+    }
+    return path + ".lua";
+}
+
+// Pushes a module the firmware already opened, reading the global first
+// so a lazy module (see luaVmSetLazyModules) gets opened
+static bool pushBuiltinModule(lua_State* L, const char* name) {
+    lua_getfield(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+    if (lua_getfield(L, -1, name) == LUA_TNIL) {
+        lua_pop(L, 1);
+        lua_getglobal(L, name);
+        lua_pop(L, 1);
+        lua_getfield(L, -1, name);
+    }
+    lua_remove(L, -2);
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        return false;
+    }
+    return true;
+}
+
+static int luaRequire(lua_State* L) {
+    const char* name = luaL_checkstring(L, 1);
+    if (pushBuiltinModule(L, name)) return 1;
+    if (!validModuleName(name)) {
+        return luaL_error(L, "invalid module name '%s'", name);
+    }
+
+    lua_rawgetp(L, LUA_REGISTRYINDEX, &librariesKey);
+    int libraries = lua_gettop(L);
+    int type = lua_getfield(L, libraries, name);
+    if (type == LUA_TBOOLEAN && !lua_toboolean(L, -1)) {
+        return luaL_error(L, "loop while loading module '%s'", name);
+    }
+    if (type != LUA_TNIL) return 1;
+    lua_pop(L, 1);
+
+    // Settle the heap first so the difference afterwards is the module
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    uint32_t before = luaHeapStats().liveBytes;
+    unsigned long start = micros();
+
+    std::string path = modulePath(name);
+    bool fromCache = false;
+    int status = luaLoadScriptFile(L, path.c_str(), LUA_BYTECODE_CACHE, &fromCache);
+    if (status == LUA_ERRFILE) {
+        return luaL_error(L, "module '%s' not found in " LUA_LIB_DIR, name);
+    }
+    if (status != LUA_OK) return lua_error(L);
+
+    lua_pushboolean(L, 0);
+    lua_setfield(L, libraries, name);
+
+    lua_pushstring(L, name);
+    lua_pushstring(L, path.c_str());
+    if (lua_pcall(L, 2, 1, 0) != LUA_OK) {
+        lua_pushnil(L);
+        lua_setfield(L, libraries, name);
+        return lua_error(L);
+    }
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        lua_pushboolean(L, 1);
+    }
+
+    // The next app gets the table as it is now, whatever this one does to it
+    if (lua_istable(L, -1)) {
+        luaVmAdoptTable(L, -1);
+    }
+    lua_pushvalue(L, -1);
+    lua_setfield(L, libraries, name);
+
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    uint32_t after = luaHeapStats().liveBytes;
+    uint32_t bytes = after > before ? after - before : 0;
+    luaHeapAddLibraryBytes(bytes);
+
+    Serial.printf("[LUA] require %s: %lu us (%s), %u bytes\n",
+                  name, micros() - start, fromCache ? "bytecode cache" : "compiled", (unsigned)bytes);
+    return 1;
+}
+
+
+void luaRequireInit(lua_State* L) {
+    lua_newtable(L);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &librariesKey);
+    lua_register(L, "require", luaRequire);
+}
@@ -0,0 +1,475 @@
+#include "lua_storage.h"
+#include "lua_app.h"
+#include "lua_fs.h"
+#include <LittleFS.h>
+#include <new>
+#include <string>
+
+extern "C" {
+#include "lua/lauxlib.h"
+}
+
+#define STORAGE_METATABLE "StorageStream"
+#define STORAGE_MAGIC "LSD\x01"
+#define STORAGE_MAGIC_SIZE 4
+#define STORAGE_MAX_NAME 32
+#define STORAGE_MAX_DEPTH 32
+#define STORAGE_BUFFER_SIZE 256
+
+// Open file plus its I/O block. Kept in a to-be-closed userdata so an
+// error raised halfway through (bad value, out of memory) closes the file,
+// and drops the temporary copy of an unfinished save, as the error
+// unwinds; __gc only backs that up.
+struct StorageStream {
+    File file;
+    std::string path;
+    bool open;
+    bool writing;
+    bool failed;
+    uint16_t pos;
+    uint16_t len;
+    uint8_t buf[STORAGE_BUFFER_SIZE];
+};
+
+struct StorageContext {
+    StorageStream* stream;
+    int seen;           // tables being written, to catch cycles
+    int strings;        // short string <-> number
+    uint32_t stringCount;
+    uint32_t fileSize;
+};
+
+
+static void closeStream(StorageStream* s, bool commit) {
+    if (!s->open) return;
+    s->open = false;
+    if (s->writing) {
+        finishAtomicWrite(s->file, s->path.c_str(), commit && !s->failed);
+    } else {
+        s->file.close();
+    }
+}
+
+static int storage_stream_close(lua_State* L) {
+    closeStream((StorageStream*)luaL_checkudata(L, 1, STORAGE_METATABLE), false);
+    return 0;
+}
+
+static int storage_stream_gc(lua_State* L) {
+    StorageStream* s = (StorageStream*)luaL_checkudata(L, 1, STORAGE_METATABLE);
+    closeStream(s, false);
+    s->~StorageStream();
+    return 0;
+}
+
+static StorageStream* newStream(lua_State* L) {
+    StorageStream* s = (StorageStream*)lua_newuserdatauv(L, sizeof(StorageStream), 0);
+    new (s) StorageStream();
+    s->open = false;
+    s->writing = false;
+    s->failed = false;
+    s->pos = 0;
+    s->len = 0;
+    luaL_setmetatable(L, STORAGE_METATABLE);
+    lua_toclose(L, -1);
+    return s;
+}
+
+// Names become file names, so keep them to one plain path component
+static const char* checkName(lua_State* L, int index) {
+    size_t len;
+    const char* name = luaL_checklstring(L, index, &len);
+    bool valid = len > 0 && len <= STORAGE_MAX_NAME && name[0] != '.';
+    for (size_t i = 0; valid && i < len; i++) {
+        char c = name[i];
+        valid = isalnum((unsigned char)c) || c == '_' || c == '-' || c == '.';
+    }
+    luaL_argcheck(L, valid, index, "name must be 1-32 letters, digits, '_', '-' or '.'");
+    return name;
+}
+
+// Resolves <data folder>/<name>.dat into s->path; false if the app has none
+static bool resolvePath(StorageStream* s, const char* name, bool create) {
+    const char* scriptPath = luaCurrentScriptPath();
+    if (!scriptPath || !*scriptPath) return false;
+    std::string filename = std::string(name) + ".dat";
+    s->path = getDataFilePath(scriptPath, filename.c_str(), create);
+    return !s->path.empty();
+}
+
+
+// ----- Writing -----
+
+static void flushStream(StorageStream* s) {
+    if (s->len > 0 && s->file.write(s->buf, s->len) != s->len) {
+        s->failed = true;
+    }
+    s->len = 0;
+}
+
+static void writeBytes(StorageStream* s, const void* data, size_t n) {
+    if (s->len + n > sizeof(s->buf)) flushStream(s);
+    if (n >= sizeof(s->buf)) {
+        if (s->file.write((const uint8_t*)data, n) != n) s->failed = true;
+        return;
+    }
+    memcpy(s->buf + s->len, data, n);
+    s->len += n;
+}
+
+static void writeByte(StorageStream* s, uint8_t b) {
+    if (s->len == sizeof(s->buf)) flushStream(s);
+    s->buf[s->len++] = b;
+}
+
+static void writeVarint(StorageStream* s, uint64_t v) {
+    while (v >= 0x80) {
+        writeByte(s, (uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    writeByte(s, (uint8_t)v);
+}
+
+static void writeValue(lua_State* L, StorageContext* ctx, int index, int depth);
+
+static void writeString(lua_State* L, StorageContext* ctx, int index) {
+    size_t len;
+    const char* str = lua_tolstring(L, index, &len);
+    
+    if (len <= STORAGE_SHORT_STRING) {
+        lua_pushvalue(L, index);
+        if (lua_rawget(L, ctx->strings) == LUA_TNUMBER) {
+            writeByte(ctx->stream, STORAGE_TAG_STRING_REF);
+            writeVarint(ctx->stream, (uint64_t)lua_tointeger(L, -1));
+            lua_pop(L, 1);
+            return;
+        }
+        lua_pop(L, 1);
+        lua_pushvalue(L, index);
+        lua_pushinteger(L, ++ctx->stringCount);
+        lua_rawset(L, ctx->strings);
+    }
+    
+    writeByte(ctx->stream, STORAGE_TAG_STRING);
+    writeVarint(ctx->stream, len);
+    writeBytes(ctx->stream, str, len);
+}
+
+static void writeTable(lua_State* L, StorageContext* ctx, int index, int depth) {
+    if (depth >= STORAGE_MAX_DEPTH) {
+        luaL_error(L, "storage.save: tables nested too deep");
+    }
+    luaL_checkstack(L, 6, "storage.save");
+    
+    lua_pushvalue(L, index);
+    if (lua_rawget(L, ctx->seen) != LUA_TNIL) {
+        luaL_error(L, "storage.save: table contains itself");
+    }
+    lua_pop(L, 1);
+    lua_pushvalue(L, index);
+    lua_pushboolean(L, 1);
+    lua_rawset(L, ctx->seen);
+    
+    lua_Integer arrayCount = (lua_Integer)lua_rawlen(L, index);
+    uint32_t hashCount = 0;
+    lua_pushnil(L);
+    while (lua_next(L, index)) {
+        lua_pop(L, 1);
+        if (!lua_isinteger(L, -1) || lua_tointeger(L, -1) < 1 || lua_tointeger(L, -1) > arrayCount) {
+            hashCount++;
+        }
+    }
+    
+    writeByte(ctx->stream, STORAGE_TAG_TABLE);
+    writeVarint(ctx->stream, (uint64_t)arrayCount);
+    writeVarint(ctx->stream, hashCount);
+    
+    for (lua_Integer i = 1; i <= arrayCount; i++) {
+        lua_rawgeti(L, index, i);
+        writeValue(L, ctx, lua_gettop(L), depth + 1);
+        lua_pop(L, 1);
+    }
+    
+    lua_pushnil(L);
+    while (lua_next(L, index)) {
+        int value = lua_gettop(L);
+        if (!lua_isinteger(L, value - 1) || lua_tointeger(L, value - 1) < 1 || lua_tointeger(L, value - 1) > arrayCount) {
+            writeValue(L, ctx, value - 1, depth + 1);
+            writeValue(L, ctx, value, depth + 1);
+        }
+        lua_pop(L, 1);
+    }
+    
+    lua_pushvalue(L, index);
+    lua_pushnil(L);
+    lua_rawset(L, ctx->seen);
+}
+
+static void writeValue(lua_State* L, StorageContext* ctx, int index, int depth) {
+    StorageStream* s = ctx->stream;
+    switch (lua_type(L, index)) {
+        case LUA_TNIL:
+            writeByte(s, STORAGE_TAG_NIL);
+            break;
+        case LUA_TBOOLEAN:
+            writeByte(s, lua_toboolean(L, index) ? STORAGE_TAG_TRUE : STORAGE_TAG_FALSE);
+            break;
+        case LUA_TNUMBER:
+            if (lua_isinteger(L, index)) {
+                int64_t v = (int64_t)lua_tointeger(L, index);
+                writeByte(s, STORAGE_TAG_INT);
+                writeVarint(s, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+            } else {
+                double d = (double)lua_tonumber(L, index);
+                uint8_t bytes[8];
+                memcpy(bytes, &d, sizeof(bytes));   // the ESP32 is little-endian
+                writeByte(s, STORAGE_TAG_FLOAT);
+                writeBytes(s, bytes, sizeof(bytes));
+            }
+            break;
+        case LUA_TSTRING:
+            writeString(L, ctx, index);
+            break;
+        case LUA_TTABLE:
+            writeTable(L, ctx, index, depth);
+            break;
+        default:
+            luaL_error(L, "storage.save: cannot save a %s", luaL_typename(L, index));
+    }
+}
+
+// storage.save(name, value) - true, or nil and a message
+static int lua_storage_save(lua_State* L) {
+    const char* name = checkName(L, 1);
+    luaL_checkany(L, 2);
+    lua_settop(L, 2);
+    
+    StorageStream* s = newStream(L);
+    if (!resolvePath(s, name, true)) {
+        lua_pushnil(L);
+        lua_pushliteral(L, "app has no data folder");
+        return 2;
+    }
+    s->file = beginAtomicWrite(s->path.c_str());
+    if (!s->file) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "cannot write %s", s->path.c_str());
+        return 2;
+    }
+    s->open = true;
+    s->writing = true;
+    
+    StorageContext ctx;
+    ctx.stream = s;
+    lua_newtable(L);
+    ctx.seen = lua_gettop(L);
+    lua_newtable(L);
+    ctx.strings = lua_gettop(L);
+    ctx.stringCount = 0;
+    ctx.fileSize = 0;
+    
+    writeBytes(s, STORAGE_MAGIC, STORAGE_MAGIC_SIZE);
+    writeValue(L, &ctx, 2, 0);
+    flushStream(s);
+    
+    bool ok = !s->failed;
+    closeStream(s, true);
+    if (!ok) {
+        lua_pushnil(L);
+        lua_pushliteral(L, "write failed (storage full?)");
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+
+// ----- Reading -----
+
+static bool fillStream(StorageStream* s) {
+    if (s->pos < s->len) return true;
+    int n = s->file.read(s->buf, sizeof(s->buf));
+    s->pos = 0;
+    s->len = n > 0 ? n : 0;
+    return s->len > 0;
+}
+
+static bool readByte(StorageStream* s, uint8_t* b) {
+    if (!fillStream(s)) return false;
+    *b = s->buf[s->pos++];
+    return true;
+}
+
+static bool readBytes(StorageStream* s, uint8_t* dst, size_t n) {
+    while (n > 0) {
+        if (!fillStream(s)) return false;
+        size_t chunk = s->len - s->pos;
+        if (chunk > n) chunk = n;
+        memcpy(dst, s->buf + s->pos, chunk);
+        s->pos += chunk;
+        dst += chunk;
+        n -= chunk;
+    }
+    return true;
+}
+
+static bool readVarint(StorageStream* s, uint64_t* v) {
+    *v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t b;
+        if (!readByte(s, &b)) return false;
+        *v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// Strings are built straight from the read block, or in a luaL_Buffer
+// when they cross a refill; never through a temporary C++ string
+static bool readString(lua_State* L, StorageContext* ctx) {
+    StorageStream* s = ctx->stream;
+    uint64_t len;
+    if (!readVarint(s, &len) || len > ctx->fileSize) return false;
+    
+    fillStream(s);
+    if (len <= (uint64_t)(s->len - s->pos)) {
+        lua_pushlstring(L, (const char*)s->buf + s->pos, (size_t)len);
+        s->pos += len;
+    } else {
+        luaL_Buffer b;
+        char* dst = luaL_buffinitsize(L, &b, (size_t)len);
+        if (!readBytes(s, (uint8_t*)dst, (size_t)len)) return false;
+        luaL_pushresultsize(&b, (size_t)len);
+    }
+    
+    if (len <= STORAGE_SHORT_STRING) {
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, ctx->strings, ++ctx->stringCount);
+    }
+    return true;
+}
+
+static bool readValue(lua_State* L, StorageContext* ctx, int depth) {
+    StorageStream* s = ctx->stream;
+    uint8_t tag;
+    uint64_t v;
+    if (depth > STORAGE_MAX_DEPTH || !readByte(s, &tag)) return false;
+    luaL_checkstack(L, 4, "storage.load");
+    
+    switch (tag) {
+        case STORAGE_TAG_NIL:
+            lua_pushnil(L);
+            return true;
+        case STORAGE_TAG_FALSE:
+        case STORAGE_TAG_TRUE:
+            lua_pushboolean(L, tag == STORAGE_TAG_TRUE);
+            return true;
+        case STORAGE_TAG_INT:
+            if (!readVarint(s, &v)) return false;
+            lua_pushinteger(L, (lua_Integer)(int64_t)((v >> 1) ^ (~(v & 1) + 1)));
+            return true;
+        case STORAGE_TAG_FLOAT: {
+            uint8_t bytes[8];
+            double d;
+            if (!readBytes(s, bytes, sizeof(bytes))) return false;
+            memcpy(&d, bytes, sizeof(d));
+            lua_pushnumber(L, (lua_Number)d);
+            return true;
+        }
+        case STORAGE_TAG_STRING:
+            return readString(L, ctx);
+        case STORAGE_TAG_STRING_REF:
+            if (!readVarint(s, &v) || v == 0 || v > ctx->stringCount) return false;
+            lua_rawgeti(L, ctx->strings, (lua_Integer)v);
+            return true;
+        case STORAGE_TAG_TABLE: {
+            uint64_t arrayCount, hashCount;
+            if (!readVarint(s, &arrayCount) || !readVarint(s, &hashCount)) return false;
+            // Every entry takes at least a byte, which bounds a corrupt count
+            if (arrayCount > ctx->fileSize || hashCount > ctx->fileSize) return false;
+            
+            lua_createtable(L, (int)arrayCount, (int)hashCount);
+            for (uint64_t i = 1; i <= arrayCount; i++) {
+                if (!readValue(L, ctx, depth + 1)) return false;
+                lua_rawseti(L, -2, (lua_Integer)i);
+            }
+            for (uint64_t i = 0; i < hashCount; i++) {
+                if (!readValue(L, ctx, depth + 1)) return false;
+                if (lua_isnil(L, -1) || !readValue(L, ctx, depth + 1)) return false;
+                lua_rawset(L, -3);
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// storage.load(name) - the saved value, or nil and a message
+static int lua_storage_load(lua_State* L) {
+    const char* name = checkName(L, 1);
+    lua_settop(L, 1);
+    
+    StorageStream* s = newStream(L);
+    if (!resolvePath(s, name, false) || !LittleFS.exists(s->path.c_str())) {
+        lua_pushnil(L);
+        lua_pushliteral(L, "not found");
+        return 2;
+    }
+    s->file = LittleFS.open(s->path.c_str(), "r");
+    if (!s->file) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "cannot read %s", s->path.c_str());
+        return 2;
+    }
+    s->open = true;
+    
+    StorageContext ctx;
+    ctx.stream = s;
+    ctx.seen = 0;
+    lua_newtable(L);
+    ctx.strings = lua_gettop(L);
+    ctx.stringCount = 0;
+    ctx.fileSize = s->file.size();
+    
+    uint8_t magic[STORAGE_MAGIC_SIZE];
+    bool ok = readBytes(s, magic, sizeof(magic)) && memcmp(magic, STORAGE_MAGIC, sizeof(magic)) == 0;
+    int top = lua_gettop(L);
+    if (ok) ok = readValue(L, &ctx, 0);
+    closeStream(s, false);
+    
+    if (!ok) {
+        lua_settop(L, top);
+        lua_pushnil(L);
+        lua_pushliteral(L, "corrupt data");
+        return 2;
+    }
+    return 1;
+}
+
+static int lua_storage_remove(lua_State* L) {
+    const char* name = checkName(L, 1);
+    lua_settop(L, 1);
+    StorageStream* s = newStream(L);
+    lua_pushboolean(L, resolvePath(s, name, false) && LittleFS.remove(s->path.c_str()));
+    return 1;
+}
+
+int luaopen_storage(lua_State* L) {
+    static const luaL_Reg storageLib[] = {
+        {"save", lua_storage_save},
+        {"load", lua_storage_load},
+        {"remove", lua_storage_remove},
+        {NULL, NULL}
+    };
+    if (luaL_newmetatable(L, STORAGE_METATABLE)) {
+        lua_pushcfunction(L, storage_stream_gc);
+        lua_setfield(L, -2, "__gc");
+        lua_pushcfunction(L, storage_stream_close);
+        lua_setfield(L, -2, "__close");
+    }
+    lua_pop(L, 1);
+    
+    luaL_newlib(L, storageLib);
+    return 1;
+}
@@ -0,0 +1,367 @@
+#include "lua_vm.h"
+
+// Registry slot holding the snapshot: { tables = { {t, copy, mt}, ... },
+// seen = { [t] = true }, registry = { [key] = true } }. seen outlives
+// luaVmSnapshot() so a table adopted later that is already recorded keeps
+// its pristine copy instead of gaining a second, post-load one.
+static const char snapshotKey = 0;
+
+// How far below _G (and each module or metatable) nested tables are
+// recorded: _G -> module -> module.sub -> module.sub.sub
+#define LUA_VM_SNAPSHOT_DEPTH 3
+
+
+// Records t, its metatable and, depth levels down, every table reachable
+// from its values
+static void snapshotTable(lua_State* L, int tableIdx, int entriesIdx, int seenIdx, int* count,
+                          int depth = LUA_VM_SNAPSHOT_DEPTH) {
+    tableIdx = lua_absindex(L, tableIdx);
+    if (!lua_istable(L, tableIdx)) return;
+    luaL_checkstack(L, 8, "VM snapshot");
+
+    lua_pushvalue(L, tableIdx);
+    if (lua_rawget(L, seenIdx) != LUA_TNIL) {
+        lua_pop(L, 1);
+        return;
+    }
+    lua_pop(L, 1);
+    lua_pushvalue(L, tableIdx);
+    lua_pushboolean(L, 1);
+    lua_rawset(L, seenIdx);
+
+    lua_createtable(L, 3, 0);
+    int entry = lua_gettop(L);
+    lua_pushvalue(L, tableIdx);
+    lua_rawseti(L, entry, 1);
+
+    lua_newtable(L);
+    int copy = lua_gettop(L);
+    lua_pushnil(L);
+    while (lua_next(L, tableIdx)) {
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, copy);
+    }
+    lua_rawseti(L, entry, 2);
+
+    if (lua_getmetatable(L, tableIdx)) {
+        lua_rawseti(L, entry, 3);
+    }
+
+    lua_rawseti(L, entriesIdx, ++(*count));
+
+    if (depth <= 0) return;
+    lua_pushnil(L);
+    while (lua_next(L, tableIdx)) {
+        snapshotTable(L, -1, entriesIdx, seenIdx, count, depth - 1);
+        lua_pop(L, 1);
+    }
+    if (lua_getmetatable(L, tableIdx)) {
+        snapshotTable(L, -1, entriesIdx, seenIdx, count, depth - 1);
+        lua_pop(L, 1);
+    }
+}
+
+// Metatables made by luaL_newmetatable() live in the registry under their
+// name; an app can reach them through getmetatable() on a userdata
+static void snapshotNamedTable(lua_State* L, int entriesIdx, int seenIdx, int* count) {
+    if (lua_type(L, -2) == LUA_TSTRING && lua_istable(L, -1)) {
+        snapshotTable(L, -1, entriesIdx, seenIdx, count, LUA_VM_SNAPSHOT_DEPTH - 1);
+    }
+}
+
+// Makes t hold exactly the pairs in copy again
+static void restoreTable(lua_State* L, int t, int copy) {
+    lua_pushnil(L);
+    while (lua_next(L, t)) {
+        lua_pushvalue(L, -2);
+        lua_rawget(L, copy);
+        if (!lua_rawequal(L, -1, -2)) {
+            // Overwriting or clearing an existing key is safe mid-traversal
+            lua_pushvalue(L, -3);
+            lua_pushvalue(L, -2);
+            lua_rawset(L, t);
+        }
+        lua_pop(L, 2);
+    }
+
+    lua_pushnil(L);
+    while (lua_next(L, copy)) {
+        lua_pushvalue(L, -2);
+        if (lua_rawget(L, t) == LUA_TNIL) {
+            lua_pop(L, 1);
+            lua_pushvalue(L, -2);
+            lua_pushvalue(L, -2);
+            lua_rawset(L, t);
+            lua_pop(L, 1);
+        } else {
+            lua_pop(L, 2);
+        }
+    }
+}
+
+static lua_Integer countPairs(lua_State* L, int t) {
+    lua_Integer n = 0;
+    lua_pushnil(L);
+    while (lua_next(L, t)) {
+        lua_pop(L, 1);
+        n++;
+    }
+    return n;
+}
+
+// True if t holds exactly the pairs in copy and has metatable mt (an
+// index holding nil for none)
+static bool tableMatches(lua_State* L, int t, int copy, int mt) {
+    if (countPairs(L, t) != countPairs(L, copy)) return false;
+    lua_pushnil(L);
+    while (lua_next(L, copy)) {
+        lua_pushvalue(L, -2);
+        lua_rawget(L, t);
+        bool same = lua_rawequal(L, -1, -2);
+        lua_pop(L, 2);
+        if (!same) {
+            lua_pop(L, 1);
+            return false;
+        }
+    }
+    if (!lua_getmetatable(L, t)) lua_pushnil(L);
+    bool sameMeta = lua_rawequal(L, -1, mt);
+    lua_pop(L, 1);
+    return sameMeta;
+}
+
+
+// Pushes a set of the registry's current keys
+static void pushRegistryKeys(lua_State* L) {
+    lua_newtable(L);
+    int keys = lua_gettop(L);
+    lua_pushnil(L);
+    while (lua_next(L, LUA_REGISTRYINDEX)) {
+        lua_pop(L, 1);
+        lua_pushvalue(L, -1);
+        lua_pushboolean(L, 1);
+        lua_rawset(L, keys);
+    }
+}
+
+// Marks a module opened after the snapshot as pristine: its table, its
+// _G and package.loaded slots, and any registry keys not in beforeKeys.
+static void adoptModule(lua_State* L, const char* name, int module, int beforeKeys) {
+    if (lua_rawgetp(L, LUA_REGISTRYINDEX, &snapshotKey) != LUA_TTABLE) {
+        lua_pop(L, 1);
+        return;
+    }
+    int top = lua_gettop(L) - 1;
+    int snapshot = lua_gettop(L);
+
+    lua_getfield(L, snapshot, "tables");
+    int entries = lua_gettop(L);
+    lua_getfield(L, snapshot, "seen");
+    int seen = lua_gettop(L);
+    int count = (int)luaL_len(L, entries);
+    snapshotTable(L, module, entries, seen, &count);
+
+    lua_pushglobaltable(L);
+    int globals = lua_gettop(L);
+    luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+    int loaded = lua_gettop(L);
+    for (int i = 1; i <= count; i++) {
+        lua_rawgeti(L, entries, i);
+        lua_rawgeti(L, -1, 1);
+        if (lua_rawequal(L, -1, globals) || lua_rawequal(L, -1, loaded)) {
+            lua_rawgeti(L, -2, 2);
+            lua_pushvalue(L, module);
+            lua_setfield(L, -2, name);
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 2);
+    }
+
+    lua_getfield(L, snapshot, "registry");
+    int keys = lua_gettop(L);
+    lua_pushnil(L);
+    while (lua_next(L, LUA_REGISTRYINDEX)) {
+        lua_pushvalue(L, -2);
+        if (lua_rawget(L, beforeKeys) == LUA_TNIL) {
+            lua_pop(L, 1);
+            snapshotNamedTable(L, entries, seen, &count);
+            lua_pushvalue(L, -2);
+            lua_pushboolean(L, 1);
+            lua_rawset(L, keys);
+        } else {
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+    }
+
+    lua_settop(L, top);
+}
+
+// __index for _G; upvalue 1 maps module names to their openers
+static int lazyModuleIndex(lua_State* L) {
+    lua_pushvalue(L, 2);
+    if (lua_rawget(L, lua_upvalueindex(1)) != LUA_TFUNCTION) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_CFunction openf = lua_tocfunction(L, -1);
+    lua_pop(L, 1);
+    const char* name = lua_tostring(L, 2);
+
+    pushRegistryKeys(L);
+    int beforeKeys = lua_gettop(L);
+    luaL_requiref(L, name, openf, 1);
+    adoptModule(L, name, lua_gettop(L), beforeKeys);
+    return 1;
+}
+
+void luaVmSetLazyModules(lua_State* L, const luaL_Reg* modules) {
+    lua_pushglobaltable(L);
+    lua_newtable(L);
+    lua_newtable(L);
+    for (const luaL_Reg* m = modules; m->name; m++) {
+        lua_pushcfunction(L, m->func);
+        lua_setfield(L, -2, m->name);
+    }
+    lua_pushcclosure(L, lazyModuleIndex, 1);
+    lua_setfield(L, -2, "__index");
+    lua_setmetatable(L, -2);
+    lua_pop(L, 1);
+}
+
+void luaVmAdoptTable(lua_State* L, int idx) {
+    idx = lua_absindex(L, idx);
+    int top = lua_gettop(L);
+    if (lua_rawgetp(L, LUA_REGISTRYINDEX, &snapshotKey) != LUA_TTABLE) {
+        lua_settop(L, top);
+        return;
+    }
+    int snapshot = lua_gettop(L);
+    lua_getfield(L, snapshot, "tables");
+    int entries = lua_gettop(L);
+    lua_getfield(L, snapshot, "seen");
+    int count = (int)luaL_len(L, entries);
+    snapshotTable(L, idx, entries, lua_gettop(L), &count);
+    lua_settop(L, top);
+}
+
+void luaVmSnapshot(lua_State* L) {
+    int top = lua_gettop(L);
+
+    lua_newtable(L);
+    int snapshot = lua_gettop(L);
+    lua_newtable(L);
+    int entries = lua_gettop(L);
+    lua_newtable(L);
+    int seen = lua_gettop(L);
+    int count = 0;
+
+    lua_pushglobaltable(L);
+    int globals = lua_gettop(L);
+    snapshotTable(L, globals, entries, seen, &count);
+
+    luaL_getsubtable(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+    snapshotTable(L, -1, entries, seen, &count);
+    lua_pop(L, 1);
+
+    lua_pushliteral(L, "");
+    if (lua_getmetatable(L, -1)) {
+        snapshotTable(L, -1, entries, seen, &count);
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+
+    lua_pushnil(L);
+    while (lua_next(L, globals)) {
+        snapshotTable(L, -1, entries, seen, &count);
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+
+    lua_pushnil(L);
+    while (lua_next(L, LUA_REGISTRYINDEX)) {
+        snapshotNamedTable(L, entries, seen, &count);
+        lua_pop(L, 1);
+    }
+
+    lua_pushvalue(L, entries);
+    lua_setfield(L, snapshot, "tables");
+    lua_pushvalue(L, seen);
+    lua_setfield(L, snapshot, "seen");
+    lua_pushvalue(L, snapshot);
+    lua_rawsetp(L, LUA_REGISTRYINDEX, &snapshotKey);
+
+    // Taken last so the snapshot's own slot counts as pristine
+    pushRegistryKeys(L);
+    lua_setfield(L, snapshot, "registry");
+
+    lua_settop(L, top);
+}
+
+bool luaVmReset(lua_State* L, int keepTop) {
+    lua_settop(L, keepTop);
+    if (lua_rawgetp(L, LUA_REGISTRYINDEX, &snapshotKey) != LUA_TTABLE) {
+        lua_settop(L, keepTop);
+        return false;
+    }
+    int snapshot = lua_gettop(L);
+
+    lua_getfield(L, snapshot, "tables");
+    int entries = lua_gettop(L);
+    lua_Integer count = luaL_len(L, entries);
+    for (lua_Integer i = 1; i <= count; i++) {
+        lua_rawgeti(L, entries, i);
+        int entry = lua_gettop(L);
+        lua_rawgeti(L, entry, 1);
+        lua_rawgeti(L, entry, 2);
+        restoreTable(L, entry + 1, entry + 2);
+        lua_rawgeti(L, entry, 3);
+        lua_setmetatable(L, entry + 1);
+        lua_settop(L, entry - 1);
+    }
+
+    lua_getfield(L, snapshot, "registry");
+    int keys = lua_gettop(L);
+    lua_pushnil(L);
+    while (lua_next(L, LUA_REGISTRYINDEX)) {
+        lua_pop(L, 1);
+        lua_pushvalue(L, -1);
+        if (lua_rawget(L, keys) == LUA_TNIL) {
+            lua_pushvalue(L, -2);
+            lua_pushnil(L);
+            lua_rawset(L, LUA_REGISTRYINDEX);
+        }
+        lua_pop(L, 1);
+    }
+
+    // Check every table against its copy, value by value, before trusting
+    // the state with the next app. The first entry is always _G.
+    lua_rawgeti(L, entries, 1);
+    lua_rawgeti(L, -1, 1);
+    lua_pushglobaltable(L);
+    bool clean = lua_rawequal(L, -1, -2);
+    lua_pop(L, 3);
+    for (lua_Integer i = 1; clean && i <= count; i++) {
+        lua_rawgeti(L, entries, i);
+        int entry = lua_gettop(L);
+        lua_rawgeti(L, entry, 1);
+        lua_rawgeti(L, entry, 2);
+        lua_rawgeti(L, entry, 3);
+        clean = tableMatches(L, entry + 1, entry + 2, entry + 3);
+        lua_settop(L, entry - 1);
+    }
+    if (clean) {
+        lua_pushnil(L);
+        while (clean && lua_next(L, LUA_REGISTRYINDEX)) {
+            lua_pop(L, 1);
+            lua_pushvalue(L, -1);
+            clean = lua_rawget(L, keys) != LUA_TNIL;
+            lua_pop(L, 1);
+        }
+    }
+
+    lua_settop(L, keepTop);
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    return clean && lua_gettop(L) == keepTop;
+}
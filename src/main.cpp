@@ -26,6 +26,7 @@
 #include "cpp_app.h"
 #include "file_explorer.h"
 #include "ir_remote.h"
+#include "serial_sync.h"
 
 
 // Create display instance(s)
@@ -94,6 +95,11 @@ void onLuaScript(const char* path, const char* name) {
     Serial.print(" from ");
     Serial.println(path);
     
+    #if LUA_PROFILER
+    // Holding right while launching profiles this run
+    setLuaProfileNextLaunch(isRightHeld());
+    #endif
+    
     setLuaScriptFromFile(path);
     startApp(luaApp);
 }
@@ -142,16 +148,11 @@ a ICON:sd Storage
 #define LED_BUILTIN 2
 #endif
 
-// Render task system - separate thread for rendering
-static volatile bool renderRequested = false;
-// Render task uses polling instead of semaphore for simplicity
-static TaskHandle_t renderTaskHandle = NULL;
-
 // Memory logging task
 static TaskHandle_t memoryLogTaskHandle = NULL;
 
 // Forward declarations
-void renderTask(void* parameter);
+void renderMenuScene();
 void requestRender();
 void memoryLogTask(void* parameter);
 
@@ -232,14 +233,13 @@ void setup() {
     scanAndCacheFolderStructure();
     
     // Add registered C++ apps to UI
-    std::vector<CppAppInfo>& cppApps = getCppApps();
     Serial.print(F("Processing "));
-    Serial.print(cppApps.size());
+    Serial.print(getCppAppCount());
     Serial.println(F(" C++ apps"));
     
-    for (const auto& app : cppApps) {
+    for (const CppAppDescriptor* app = cppAppsBegin(); app != cppAppsEnd(); app++) {
         // Create all parent folders in the path
-        std::string uiPath = app.uiPath;
+        std::string uiPath = app->uiPath;
         
         // Build path progressively and create missing folders
         std::string currentPath = "";
@@ -274,12 +274,12 @@ void setup() {
         }
         
         // Add C++ app
-        addApp(app.uiPath.c_str(), onCppApp, "app");
+        addApp(app->uiPath, onCppApp, app->icon);
         
         Serial.print(F("Added C++ app: "));
-        Serial.print(app.name.c_str());
+        Serial.print(app->name);
         Serial.print(F(" at "));
-        Serial.println(app.uiPath.c_str());
+        Serial.println(app->uiPath);
     }
     
     // Initialize menu
@@ -289,21 +289,9 @@ void setup() {
     Serial.print(F("Total entries: "));
     Serial.println(getEntryCount());
     
-    // Initialize the centralized render queue (for apps)
-    initRenderQueue();
-    
-    // Create render task semaphore and task (for menu)
-    // Render task uses polling - no semaphore needed
-    xTaskCreatePinnedToCore(
-        renderTask,       // Task function
-        "RenderTask",     // Name
-        4096,             // Stack size
-        NULL,             // Parameters
-        1,                // Priority (low, input handling is more important)
-        &renderTaskHandle,// Task handle
-        0                 // Run on Core 0 (main loop runs on Core 1)
-    );
-    Serial.println(F("Render task created on Core 0"));
+    // Start the compositor task (owns menu scenes and app flushes)
+    setCompositorMenuScene(renderMenuScene);
+    initCompositor();
     
     // Create memory logging task - runs on Core 0 with low priority (non-critical)
     xTaskCreatePinnedToCore(
@@ -313,7 +301,7 @@ void setup() {
         NULL,                  // Parameters
         0,                     // Low priority (non-critical, just logging)
         &memoryLogTaskHandle,  // Task handle
-        0                      // Run on Core 0 (same as render task)
+        0                      // Run on Core 0 (same as compositor)
     );
     Serial.println(F("Memory logging task created on Core 0 (low priority)"));
     
@@ -358,35 +346,11 @@ static bool epaperIsUpdating = false;
 #define EPAPER_DEBOUNCE_MS 500  // Wait 500ms after last input before updating e-Paper
 #endif
 
-// Render task runs on Core 0 (app logic runs on Core 1)
-void renderTask(void* parameter) {
-    while (true) {
-        // Check if render is requested
-        if (renderRequested && !isAppRunning()) {
-            renderRequested = false;
-            acquireDisplayLock();
-            setLEDBusy();
-            
-            #if DISPLAY_TYPE == DUAL
-                // Render to OLED (fast)
-                renderMenu(true);
-            #elif DISPLAY_TYPE == EPAPER
-                // e-Paper only mode
-                renderMenu(true);
-            #else
-                // SSD1306 only
-                renderMenu(true);
-            #endif
-            
-            setLEDReady();
-            releaseDisplayLock();
-            // Loop immediately to check for more render requests
-            vTaskDelay(1); // Small delay to avoid WDT trigger if loop is tight
-        } else {
-            // Nothing to render, small yield
-            vTaskDelay(10 / portTICK_PERIOD_MS);
-        }
-    }
+// Menu scene, drawn by the compositor on Core 0 (app logic runs on Core 1)
+void renderMenuScene() {
+    setLEDBusy();
+    renderMenu(true);
+    setLEDReady();
 }
 
 // Memory logging task - logs free heap periodically
@@ -423,6 +387,7 @@ void memoryLogTask(void* parameter) {
             Serial.print(F(" [LOW MEMORY!]"));
         }
         Serial.println();
+        printCompositorStats();
         
         // Use shorter interval if memory is low, otherwise normal interval
         TickType_t logInterval = isLowMemory ? lowMemLogInterval : normalLogInterval;
@@ -430,10 +395,9 @@ void memoryLogTask(void* parameter) {
     }
 }
 
-// Request a render (non-blocking)
+// Request a menu render (non-blocking, coalesced by the compositor)
 void requestRender() {
-    renderRequested = true;
-    // No semaphore needed - render task polls renderRequested
+    requestMenuRender();
 }
 
 void loop() {
@@ -460,6 +424,12 @@ void loop() {
     }
     
     // Normal menu mode
+    #if SERIAL_SYNC
+    if (serialSyncPoll()) {
+        requestRender();
+    }
+    #endif
+    
     // Update control inputs
     updateControls();
     
@@ -487,7 +457,7 @@ void loop() {
     // Request render on input (only if no app started)
     if (hadInput && !isAppRunning()) {
         #if DISPLAY_TYPE == DUAL
-            // Request OLED render (handled by render task)
+            // Request OLED render (handled by compositor)
             requestRender();
             // Mark e-Paper as needing update, reset debounce timer
             epaperNeedsUpdate = true;
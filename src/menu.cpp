@@ -354,3 +354,13 @@ int getVisibleItemCount() {
 void invalidateMenu() {
     menuNeedsRedraw = true;
 }
+
+void refreshMenuEntries() {
+    updateCurrentEntries();
+    int count = getVisibleItemCount();
+    if (selectedIndex >= count) {
+        selectedIndex = count > 0 ? count - 1 : 0;
+    }
+    lastRenderedPath = "";
+    menuNeedsRedraw = true;
+}
@@ -0,0 +1,204 @@
+#include "serial_sync.h"
+#include "config.h"
+#include "filesystem.h"
+#include "menu.h"
+#include "utils.h"
+#include "lua_fs.h"
+#include "lua_bytecode.h"
+#include "lua_require.h"
+#include "lua_app.h"
+#include <LittleFS.h>
+#include <string>
+
+#define SYNC_LINE_MAX 192
+#define SYNC_TIMEOUT_MS 3000
+
+static char lineBuf[SYNC_LINE_MAX];
+static size_t lineLen = 0;
+static bool lineOverflow = false;
+static uint32_t changedFiles = 0;
+
+
+static void reply(const char* fmt, ...) {
+    char buf[96];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    Serial.print(F("@SYNC "));
+    Serial.println(buf);
+}
+
+// Only absolute paths without ".." components
+static bool validPath(const char* path) {
+    size_t len = strlen(path);
+    bool endsInParent = len >= 3 && strcmp(path + len - 3, "/..") == 0;
+    return path[0] == '/' && !strstr(path, "/../") && !endsInParent;
+}
+
+static bool hashFile(const char* path, uint32_t* size, uint32_t* hash) {
+    File file = LittleFS.open(path, "r");
+    if (!file || file.isDirectory()) return false;
+    
+    uint8_t buf[256];
+    *size = file.size();
+    *hash = luaSourceHash(nullptr, 0);
+    int n;
+    while ((n = file.read(buf, sizeof(buf))) > 0) {
+        *hash = luaSourceHash((const char*)buf, n, *hash);
+    }
+    file.close();
+    return true;
+}
+
+static void makeParentDirs(const char* path) {
+    std::string dir = path;
+    for (size_t slash = dir.find('/', 1); slash != std::string::npos; slash = dir.find('/', slash + 1)) {
+        std::string parent = dir.substr(0, slash);
+        if (!LittleFS.exists(parent.c_str())) {
+            LittleFS.mkdir(parent.c_str());
+        }
+    }
+}
+
+// A changed script makes its compiled chunk stale, and a changed library
+// the modules the warm VM keeps loaded
+static void invalidateCaches(const char* path) {
+    size_t len = strlen(path);
+    if (len > 4 && strcmp(path + len - 4, ".lua") == 0) {
+        luaInvalidateCachedChunk(path);
+    }
+    if (strncmp(path, LUA_LIB_DIR "/", sizeof(LUA_LIB_DIR)) == 0) {
+        releaseWarmLuaVM();
+    }
+    changedFiles++;
+}
+
+static size_t readWithTimeout(uint8_t* dst, size_t n) {
+    size_t got = 0;
+    uint32_t lastData = millis();
+    while (got < n && millis() - lastData < SYNC_TIMEOUT_MS) {
+        int avail = Serial.available();
+        if (avail > 0) {
+            got += Serial.readBytes(dst + got, min((size_t)avail, n - got));
+            lastData = millis();
+        } else {
+            delay(1);
+        }
+    }
+    return got;
+}
+
+static void handlePut(uint32_t size, uint32_t expectedHash, const char* path) {
+    makeParentDirs(path);
+    File file = beginAtomicWrite(path);
+    if (!file) {
+        reply("ERR cannot write %s", path);
+        return;
+    }
+    reply("READY");
+    
+    uint8_t chunk[SERIAL_SYNC_CHUNK_SIZE];
+    uint32_t received = 0;
+    uint32_t hash = luaSourceHash(nullptr, 0);
+    bool ok = true;
+    while (received < size) {
+        size_t want = min((uint32_t)sizeof(chunk), size - received);
+        size_t got = readWithTimeout(chunk, want);
+        if (got != want) {
+            ok = false;
+            reply("ERR timeout after %u bytes", (unsigned)(received + got));
+            break;
+        }
+        if (file.write(chunk, got) != got) {
+            ok = false;
+            reply("ERR write failed (storage full?)");
+            break;
+        }
+        hash = luaSourceHash((const char*)chunk, got, hash);
+        received += got;
+        reply("ACK %u", (unsigned)received);
+    }
+    
+    if (ok && hash != expectedHash) {
+        ok = false;
+        reply("ERR hash mismatch");
+    }
+    if (!finishAtomicWrite(file, path, ok)) {
+        if (ok) reply("ERR cannot replace %s", path);
+        return;
+    }
+    invalidateCaches(path);
+    Serial.printf("[SYNC] wrote %s (%u bytes)\n", path, (unsigned)size);
+    reply("DONE");
+}
+
+static bool handleLine(char* line) {
+    if (strncmp(line, "SYNC ", 5) != 0) return false;
+    char* cmd = line + 5;
+    unsigned long size, hash;
+    int pathStart = 0;
+    
+    if (strcmp(cmd, "HELLO") == 0) {
+        changedFiles = 0;
+        reply("OK %d %d", SERIAL_SYNC_VERSION, SERIAL_SYNC_CHUNK_SIZE);
+    } else if (sscanf(cmd, "CHECK %lu %lx %n", &size, &hash, &pathStart) == 2 && pathStart > 0) {
+        uint32_t fileSize, fileHash;
+        const char* path = cmd + pathStart;
+        bool same = hashFile(path, &fileSize, &fileHash) && fileSize == size && fileHash == hash;
+        reply(same ? "SAME" : "DIFF");
+    } else if (sscanf(cmd, "PUT %lu %lx %n", &size, &hash, &pathStart) == 2 && pathStart > 0) {
+        const char* path = cmd + pathStart;
+        if (!validPath(path)) {
+            reply("ERR bad path");
+        } else {
+            handlePut(size, hash, path);
+        }
+    } else if (strncmp(cmd, "DEL ", 4) == 0) {
+        const char* path = cmd + 4;
+        if (validPath(path) && LittleFS.remove(path)) {
+            invalidateCaches(path);
+            reply("DONE");
+        } else {
+            reply("ERR cannot delete %s", path);
+        }
+    } else if (strcmp(cmd, "END") == 0) {
+        reply("OK %u", (unsigned)changedFiles);
+        return changedFiles > 0;
+    } else {
+        reply("ERR unknown command");
+    }
+    return false;
+}
+
+bool serialSyncPoll() {
+    bool ended = false;
+    while (!ended && Serial.available() > 0) {
+        char c = Serial.read();
+        if (c == '\r') continue;
+        if (c != '\n') {
+            if (lineLen < sizeof(lineBuf) - 1) {
+                lineBuf[lineLen++] = c;
+            } else {
+                lineOverflow = true;
+            }
+            continue;
+        }
+        
+        lineBuf[lineLen] = '\0';
+        if (!lineOverflow) {
+            ended = handleLine(lineBuf);
+        }
+        lineLen = 0;
+        lineOverflow = false;
+    }
+    if (!ended) return false;
+    
+    // New, renamed or removed apps: rebuild the cached menu tree
+    acquireDisplayLock();
+    rescanDynamicFolders();
+    refreshMenuEntries();
+    releaseDisplayLock();
+    changedFiles = 0;
+    return true;
+}
@@ -1,6 +1,8 @@
 #include "utils.h"
 #include "config.h"
+#include "app_runner.h"
 #include <string.h>
+#include <limits.h>
 #include <string>
 #include <algorithm>
 #include <memory>
@@ -272,12 +274,30 @@ void setLEDReady() {
 
 static SemaphoreHandle_t displayMutex = NULL;
 
+
+static volatile uint32_t lockAcquisitions = 0;
+static volatile uint32_t lockContended = 0;
+static volatile uint32_t lockWaitTotalUs = 0;
+static volatile uint32_t lockWaitMaxUs = 0;
+
 void acquireDisplayLock() {
     if (!displayMutex) {
         displayMutex = xSemaphoreCreateRecursiveMutex();
     }
     if (displayMutex) {
+        if (xSemaphoreTakeRecursive(displayMutex, 0) == pdTRUE) {
+            lockAcquisitions++;
+            return;
+        }
+        
+        
+        uint32_t waitStart = micros();
         xSemaphoreTakeRecursive(displayMutex, portMAX_DELAY);
+        uint32_t waited = micros() - waitStart;
+        lockAcquisitions++;
+        lockContended++;
+        lockWaitTotalUs += waited;
+        if (waited > lockWaitMaxUs) lockWaitMaxUs = waited;
     }
 }
 
@@ -287,65 +307,123 @@ void releaseDisplayLock() {
     }
 }
 
+bool isDisplayLockHeldBy(TaskHandle_t task) {
+    if (!displayMutex || !task) return false;
+    return xSemaphoreGetMutexHolder(displayMutex) == task;
+}
+
 
 
 
 
 
-static QueueHandle_t renderQueue = NULL;
-static TaskHandle_t renderTaskHandle = NULL;
-static volatile bool renderQueueInitialized = false;
+// Compositor: the single task on core 0 that owns the panel. Producers
+// never touch the flush path directly; they set a notification bit and
+// the compositor applies the coalescing rules below when it wakes:
+//
+//  1. Requests of the same kind posted before the compositor runs merge
+//     into one (notification bits, not a counted queue).
+//  2. A menu scene render already ends in a full flush, so a pending app
+//     flush is absorbed by it.
+//  3. Menu scenes are dropped while an app owns the screen; apps redraw
+//     themselves and ask for flushes.
+//  4. On partial-update e-paper, a flush waits RENDER_QUEUE_SETTLE_MS and
+//     absorbs anything posted meanwhile before touching the panel.
+#define COMPOSITOR_FLUSH (1UL << 0)
+#define COMPOSITOR_MENU  (1UL << 1)
+
+static TaskHandle_t compositorTaskHandle = NULL;
+static volatile bool compositorInitialized = false;
 static volatile bool renderBusy = false;
 static SemaphoreHandle_t initMutex = NULL;
+static CompositorSceneFunc menuScene = nullptr;
+
+
+static volatile uint32_t pendingRequests = 0;
+static volatile uint32_t maxPendingRequests = 0;
+static volatile uint32_t flushRequests = 0;
+static volatile uint32_t menuRequests = 0;
+static volatile uint32_t flushesDone = 0;
+static volatile uint32_t menuRendersDone = 0;
+static volatile uint32_t menuRendersDropped = 0;
+static portMUX_TYPE compositorStatsMux = portMUX_INITIALIZER_UNLOCKED;
 
 // Loading screen state (declared early so requestDisplayRefresh can access it)
 static bool loadingScreenVisible = false;
 static bool loadingScreenNeedsFlush = false;
 
 
+static void flushDisplayNow() {
+    if (!display) return;
+    acquireDisplayLock();
+    setLEDBusy();
+    display->display();
+    setLEDReady();
+    releaseDisplayLock();
+}
 
-static void renderQueueTask(void* parameter) {
-    uint8_t dummy;
+static void compositorTask(void* parameter) {
+    uint32_t bits = 0;
     
     while (true) {
+        xTaskNotifyWait(0, ULONG_MAX, &bits, portMAX_DELAY);
         
-        if (xQueueReceive(renderQueue, &dummy, portMAX_DELAY) == pdTRUE) {
-            
-            
-            
-            int queuedCount = 1;  
-            while (xQueueReceive(renderQueue, &dummy, 0) == pdTRUE) {
-                queuedCount++;
+        #if (DISPLAY_TYPE == EPAPER || DISPLAY_TYPE == DUAL) && EPAPER_COLOR_MODE == EPAPER_BW && !EPAPER_USE_FULL_UPDATE
+        if (bits & COMPOSITOR_FLUSH) {
+            // Keep absorbing until the whole window has passed, not just
+            // until the first request that arrives in it
+            TickType_t settleStart = xTaskGetTickCount();
+            TickType_t settleTicks = pdMS_TO_TICKS(RENDER_QUEUE_SETTLE_MS);
+            TickType_t elapsed;
+            while ((elapsed = xTaskGetTickCount() - settleStart) < settleTicks) {
+                uint32_t more = 0;
+                if (xTaskNotifyWait(0, ULONG_MAX, &more, settleTicks - elapsed) == pdTRUE) {
+                    bits |= more;
+                }
             }
-            
-            
-            
-            
-            renderBusy = true;
-            acquireDisplayLock();
-            
-            #if (DISPLAY_TYPE == EPAPER || DISPLAY_TYPE == DUAL) && EPAPER_COLOR_MODE == EPAPER_BW && !EPAPER_USE_FULL_UPDATE
-            
-            
-            vTaskDelay(pdMS_TO_TICKS(RENDER_QUEUE_SETTLE_MS));
-            #endif
-            
-            
-            
-            
-            if (display) {
-                setLEDBusy();
-                display->display();  
-                setLEDReady();
+        }
+        #endif
+        
+        portENTER_CRITICAL(&compositorStatsMux);
+        pendingRequests = 0;
+        portEXIT_CRITICAL(&compositorStatsMux);
+        
+        renderBusy = true;
+        
+        bool menuDrawn = false;
+        if (bits & COMPOSITOR_MENU) {
+            if (menuScene && !isAppRunning()) {
+                acquireDisplayLock();
+                menuScene();
+                releaseDisplayLock();
+                menuRendersDone++;
+                menuDrawn = true;
+            } else {
+                menuRendersDropped++;
             }
-            
-            releaseDisplayLock();
-            renderBusy = false;
         }
+        
+        if ((bits & COMPOSITOR_FLUSH) && !menuDrawn) {
+            flushDisplayNow();
+            flushesDone++;
+        }
+        
+        renderBusy = false;
     }
 }
 
-void initRenderQueue() {
+static void postCompositorRequest(uint32_t bit) {
+    portENTER_CRITICAL(&compositorStatsMux);
+    if (bit == COMPOSITOR_MENU) menuRequests++;
+    else flushRequests++;
+    pendingRequests++;
+    if (pendingRequests > maxPendingRequests) maxPendingRequests = pendingRequests;
+    portEXIT_CRITICAL(&compositorStatsMux);
+    
+    xTaskNotify(compositorTaskHandle, bit, eSetBits);
+}
+
+void initCompositor() {
     
     if (!initMutex) {
         initMutex = xSemaphoreCreateMutex();
@@ -356,7 +434,7 @@ void initRenderQueue() {
     }
     
     
-    if (renderQueueInitialized) {
+    if (compositorInitialized) {
         if (initMutex) {
             xSemaphoreGive(initMutex);
         }
@@ -364,23 +442,20 @@ void initRenderQueue() {
     }
     
     
-    
-    renderQueue = xQueueCreate(256, sizeof(uint8_t));
-    
-    if (renderQueue) {
-        
-        xTaskCreatePinnedToCore(
-            renderQueueTask,
-            "RenderQueue",
+    if (xTaskCreatePinnedToCore(
+            compositorTask,
+            "Compositor",
             4096,
             NULL,
             1,  
-            &renderTaskHandle,
+            &compositorTaskHandle,
             0   
-        );
-        
-        renderQueueInitialized = true;
-        Serial.println(F("Render queue initialized"));
+        ) == pdPASS) {
+        compositorInitialized = true;
+        Serial.println(F("Compositor task created on Core 0"));
+    } else {
+        compositorTaskHandle = NULL;
+        Serial.println(F("Failed to create compositor task"));
     }
     
     if (initMutex) {
@@ -388,46 +463,46 @@ void initRenderQueue() {
     }
 }
 
+void setCompositorMenuScene(CompositorSceneFunc scene) {
+    menuScene = scene;
+}
+
+void requestMenuRender() {
+    if (!compositorInitialized) {
+        initCompositor();
+    }
+    
+    if (!compositorTaskHandle) {
+        if (menuScene && !isAppRunning()) {
+            acquireDisplayLock();
+            menuScene();
+            releaseDisplayLock();
+        }
+        return;
+    }
+    
+    postCompositorRequest(COMPOSITOR_MENU);
+}
+
 void requestDisplayRefresh() {
     // If loading screen is visible and was just drawn, flush it once and skip queue
     if (loadingScreenVisible && loadingScreenNeedsFlush) {
         // Flush the loading screen once, then clear the flag
-        if (display) {
-            acquireDisplayLock();
-            setLEDBusy();
-            display->display();
-            setLEDReady();
-            releaseDisplayLock();
-        }
+        flushDisplayNow();
         loadingScreenNeedsFlush = false;
         return;
     }
     
-    if (!renderQueueInitialized) {
-        initRenderQueue();
+    if (!compositorInitialized) {
+        initCompositor();
     }
     
-    if (!renderQueue) {
-        
-        if (display) {
-            acquireDisplayLock();
-            setLEDBusy();
-            display->display();
-            setLEDReady();
-            releaseDisplayLock();
-        }
+    if (!compositorTaskHandle) {
+        flushDisplayNow();
         return;
     }
     
-    
-    
-    
-    
-    
-    
-    
-    uint8_t dummy = 1;
-    xQueueSend(renderQueue, &dummy, 0);  
+    postCompositorRequest(COMPOSITOR_FLUSH);
 }
 
 bool isRenderBusy() {
@@ -435,8 +510,36 @@ bool isRenderBusy() {
 }
 
 bool isRenderPending() {
-    if (!renderQueue) return false;
-    return uxQueueMessagesWaiting(renderQueue) > 0;
+    return pendingRequests > 0;
+}
+
+void printCompositorStats() {
+    uint32_t requests = flushRequests + menuRequests;
+    uint32_t served = flushesDone + menuRendersDone + menuRendersDropped;
+    
+    Serial.print(F("[GFX] Requests: "));
+    Serial.print(requests);
+    Serial.print(F(" (flush "));
+    Serial.print(flushRequests);
+    Serial.print(F(", menu "));
+    Serial.print(menuRequests);
+    Serial.print(F(") | Coalesced: "));
+    Serial.print(requests > served ? requests - served : 0);
+    Serial.print(F(" | Dropped menu: "));
+    Serial.print(menuRendersDropped);
+    Serial.print(F(" | Depth: "));
+    Serial.print(pendingRequests);
+    Serial.print(F(" (max "));
+    Serial.print(maxPendingRequests);
+    Serial.print(F(") | Lock contended: "));
+    Serial.print(lockContended);
+    Serial.print(F("/"));
+    Serial.print(lockAcquisitions);
+    Serial.print(F(", avg wait "));
+    Serial.print(lockContended ? lockWaitTotalUs / lockContended : 0);
+    Serial.print(F("us, max "));
+    Serial.print(lockWaitMaxUs);
+    Serial.println(F("us"));
 }
 
 
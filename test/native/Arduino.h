@@ -0,0 +1,12 @@
+// Host stand-in for the Arduino core, for the native test environment.
+// Only what the firmware sources built there (see test_build_src in
+// platformio.ini) pull in through their #include <Arduino.h>.
+#ifndef ARDUINO_H_NATIVE_STUB
+#define ARDUINO_H_NATIVE_STUB
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+#endif
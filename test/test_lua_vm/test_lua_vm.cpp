@@ -0,0 +1,184 @@
+// Warm VM isolation (src/lua_vm.cpp): whatever one app does to globals,
+// modules, nested tables, metatables and the registry must be gone after
+// luaVmReset(). Runs on the host: pio test -e native
+#include <unity.h>
+#include "lua_vm.h"
+
+extern "C" {
+#include "lua/lualib.h"
+}
+
+static lua_State* L = nullptr;
+
+static int newHandle(lua_State* L, const char* metatable) {
+    lua_newuserdatauv(L, 1, 0);
+    luaL_setmetatable(L, metatable);
+    return 1;
+}
+
+static int modHandle(lua_State* L) {
+    return newHandle(L, "ModHandle");
+}
+
+static int lazyNew(lua_State* L) {
+    return newHandle(L, "LazyHandle");
+}
+
+// A module opened before the snapshot, with nested tables and a
+// userdata metatable
+static int openMod(lua_State* L) {
+    luaL_newmetatable(L, "ModHandle");
+    lua_newtable(L);
+    lua_pushliteral(L, "handle");
+    lua_setfield(L, -2, "kind");
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+
+    lua_newtable(L);
+    lua_pushinteger(L, 1);
+    lua_setfield(L, -2, "value");
+    lua_pushcfunction(L, modHandle);
+    lua_setfield(L, -2, "handle");
+    lua_newtable(L);
+    lua_pushinteger(L, 1);
+    lua_setfield(L, -2, "speed");
+    lua_newtable(L);
+    lua_pushinteger(L, 1);
+    lua_setfield(L, -2, "deep");
+    lua_setfield(L, -2, "nested");
+    lua_setfield(L, -2, "config");
+    return 1;
+}
+
+// A module the first app opens lazily, after the snapshot
+static int openLazy(lua_State* L) {
+    luaL_newmetatable(L, "LazyHandle");
+    lua_pop(L, 1);
+
+    lua_newtable(L);
+    lua_pushboolean(L, 1);
+    lua_setfield(L, -2, "opened");
+    lua_pushcfunction(L, lazyNew);
+    lua_setfield(L, -2, "new");
+    return 1;
+}
+
+static const luaL_Reg lazyModules[] = {
+    {"lazy", openLazy},
+    {NULL, NULL}
+};
+
+static const char appScript[] =
+    "newGlobal = 1\n"
+    "print = nil\n"
+    "tostring = function() return 'leak' end\n"
+    "mod.value = 2\n"
+    "mod.extra = {}\n"
+    "mod.config.speed = 99\n"
+    "mod.config.added = true\n"
+    "mod.config.nested.deep = 42\n"
+    "setmetatable(mod, {__index = function() return 'leak' end})\n"
+    "getmetatable('').__index = {upper = function() return 'leak' end}\n"
+    "getmetatable('').__add = function() return 0 end\n"
+    "getmetatable(mod.handle()).__index.kind = 'changed'\n"
+    "getmetatable(mod.handle()).__gc = function() end\n"
+    "lazy.opened = false\n"
+    "getmetatable(lazy.new()).__tostring = function() return 'leak' end\n";
+
+static const char pristineScript[] =
+    "assert(newGlobal == nil, 'new global kept')\n"
+    "assert(type(print) == 'function', 'removed global not restored')\n"
+    "assert(tostring(1) == '1', 'replaced global not restored')\n"
+    "assert(mod.value == 1, 'module field kept')\n"
+    "assert(rawget(mod, 'extra') == nil, 'module field added')\n"
+    "assert(getmetatable(mod) == nil, 'module metatable kept')\n"
+    "assert(mod.config.speed == 1 and mod.config.added == nil, 'nested table kept')\n"
+    "assert(mod.config.nested.deep == 1, 'deeply nested table kept')\n"
+    "assert(('a'):upper() == 'A', 'string metatable kept')\n"
+    "assert(getmetatable('').__add == nil, 'string metamethod kept')\n"
+    "assert(getmetatable(mod.handle()).__index.kind == 'handle', 'userdata metatable kept')\n"
+    "assert(getmetatable(mod.handle()).__gc == nil, 'userdata metamethod kept')\n"
+    "assert(lazy.opened == true, 'lazy module kept')\n"
+    "assert(tostring(lazy.new()):find('^LazyHandle'), 'lazy metatable kept')\n";
+
+static void runLua(const char* code) {
+    int status = luaL_dostring(L, code);
+    TEST_ASSERT_EQUAL_MESSAGE(LUA_OK, status, status == LUA_OK ? "" : lua_tostring(L, -1));
+}
+
+// What an app leaves in the registry from C: refs and its own metatables
+static int addRegistryLeftovers() {
+    luaL_newmetatable(L, "AppMeta");
+    lua_pop(L, 1);
+    lua_newtable(L);
+    return luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+static void assertRegistryClean(int ref) {
+    TEST_ASSERT_EQUAL(LUA_TNIL, luaL_getmetatable(L, "AppMeta"));
+    lua_pop(L, 1);
+    TEST_ASSERT_EQUAL(LUA_TNIL, lua_rawgeti(L, LUA_REGISTRYINDEX, ref));
+    lua_pop(L, 1);
+}
+
+void setUp() {
+    L = luaL_newstate();
+    luaL_requiref(L, LUA_GNAME, luaopen_base, 1);
+    luaL_requiref(L, LUA_STRLIBNAME, luaopen_string, 1);
+    luaL_requiref(L, "mod", openMod, 1);
+    lua_settop(L, 0);
+    luaVmSetLazyModules(L, lazyModules);
+    luaVmSnapshot(L);
+}
+
+void tearDown() {
+    lua_close(L);
+    L = nullptr;
+}
+
+static void test_reset_restores_pristine_state() {
+    runLua(appScript);
+    int ref = addRegistryLeftovers();
+
+    TEST_ASSERT_TRUE(luaVmReset(L, 0));
+    runLua(pristineScript);
+    assertRegistryClean(ref);
+    TEST_ASSERT_EQUAL(0, lua_gettop(L));
+}
+
+static void test_reset_holds_across_launches() {
+    for (int launch = 0; launch < 3; launch++) {
+        runLua(appScript);
+        addRegistryLeftovers();
+        TEST_ASSERT_TRUE(luaVmReset(L, 0));
+        runLua(pristineScript);
+    }
+}
+
+// A library that returns a table the snapshot already holds (return mod)
+// must not replace its pristine copy with the state at require time
+static void test_adopt_keeps_pristine_copy() {
+    runLua("mod.value = 2\n"
+           "mod.config.speed = 99\n");
+    lua_getglobal(L, "mod");
+    luaVmAdoptTable(L, -1);
+    lua_pop(L, 1);
+
+    TEST_ASSERT_TRUE(luaVmReset(L, 0));
+    runLua(pristineScript);
+}
+
+static void test_reset_without_snapshot_fails() {
+    lua_State* bare = luaL_newstate();
+    TEST_ASSERT_FALSE(luaVmReset(bare, 0));
+    lua_close(bare);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_reset_restores_pristine_state);
+    RUN_TEST(test_reset_holds_across_launches);
+    RUN_TEST(test_adopt_keeps_pristine_copy);
+    RUN_TEST(test_reset_without_snapshot_fails);
+    return UNITY_END();
+}
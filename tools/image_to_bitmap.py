@@ -0,0 +1,65 @@
+
+"""
+Convert an image or sprite sheet into the packed 1bpp bitmap format read by
+display.loadBitmap().
+
+Usage:
+    python image_to_bitmap.py input.png output.bm [--frames N] [--threshold T] [--invert]
+
+Options:
+    --frames N       Split the image into N equal frames, left to right (default: 1)
+    --threshold T    Pixels at or above this brightness (0-255) are set (default: 128)
+    --invert         Set dark pixels instead of bright ones
+"""
+
+import argparse
+import struct
+import sys
+from PIL import Image
+
+
+def pack_frame(img, threshold, invert):
+    """Pack one frame into rows of MSB-first bytes."""
+    width, height = img.size
+    pixels = img.load()
+    out = bytearray()
+    for y in range(height):
+        for x0 in range(0, width, 8):
+            byte = 0
+            for bit in range(8):
+                x = x0 + bit
+                if x < width and (pixels[x, y] >= threshold) != invert:
+                    byte |= 0x80 >> bit
+            out.append(byte)
+    return out
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert an image to a 1bpp .bm bitmap")
+    parser.add_argument("input")
+    parser.add_argument("output")
+    parser.add_argument("--frames", type=int, default=1)
+    parser.add_argument("--threshold", type=int, default=128)
+    parser.add_argument("--invert", action="store_true")
+    args = parser.parse_args()
+
+    img = Image.open(args.input).convert("L")
+    width, height = img.size
+    if args.frames < 1 or width % args.frames != 0:
+        print("image width %d does not split into %d frames" % (width, args.frames))
+        return 1
+    frame_width = width // args.frames
+
+    data = bytearray(struct.pack("<2sHHH", b"B1", frame_width, height, args.frames))
+    for i in range(args.frames):
+        frame = img.crop((i * frame_width, 0, (i + 1) * frame_width, height))
+        data += pack_frame(frame, args.threshold, args.invert)
+
+    with open(args.output, "wb") as f:
+        f.write(data)
+    print("%s: %d frame(s) of %dx%d, %d bytes" % (args.output, args.frames, frame_width, height, len(data)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
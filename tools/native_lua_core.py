@@ -0,0 +1,20 @@
+"""
+PlatformIO extra script for the native test environment.
+
+The host tests need only Lua's C core from the Esp32Lua library. Its
+Arduino wrapper (C++ sources) does not build against the test/native
+Arduino.h stand-in, and the standalone lua.c/luac.c interpreters, where
+a release ships them, bring a main() of their own that clashes with the
+test runner's. Both are dropped from the build:
+    extra_scripts = tools/native_lua_core.py
+"""
+
+Import("env")  # noqa: F821 - provided by PlatformIO
+
+
+def skip_node(node):
+    return None
+
+
+for pattern in ("*Esp32Lua*.cpp", "*/lua.c", "*/luac.c"):
+    env.AddBuildMiddleware(skip_node, pattern)  # noqa: F821
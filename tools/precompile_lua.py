@@ -0,0 +1,143 @@
+
+"""
+Precompile Lua apps in data/ into the on-device bytecode cache format.
+
+Usage:
+    python precompile_lua.py [DATA_DIR] [--luac LUAC] [--clean]
+
+Options:
+    DATA_DIR      Folder to scan for .lua files (default: data)
+    --luac LUAC   Host Lua 5.4 compiler (default: $LUAC, luac5.4, luac54, luac)
+    --clean       Remove existing .luac files instead of writing them
+
+Also works as a PlatformIO extra script, running before the filesystem
+image is built. It must be a post: script; ESP32_FS_IMAGE_NAME, which
+names the image target, is only set by the platform's builder:
+    extra_scripts = post:tools/precompile_lua.py
+
+Every <script>.lua gets a <script>.luac next to it: a 16-byte header
+(magic "LBC1", Lua version, flags, source size, FNV-1a hash of the source)
+followed by the chunk from luac. The device only loads a cache whose
+size and hash still match the script, so stale files are ignored.
+"""
+
+import argparse
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+MAGIC = b"LBC1"
+LUA_VERSION_NUM = 504
+
+
+def fnv1a(data):
+    """32-bit FNV-1a, identical to luaSourceHash() in src/lua_bytecode.cpp."""
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def find_luac(preferred=None):
+    """Return a host compiler that reports Lua 5.4, or None."""
+    candidates = [preferred, os.environ.get("LUAC"), "luac5.4", "luac54", "luac"]
+    for name in candidates:
+        if not name:
+            continue
+        path = shutil.which(name)
+        if not path:
+            continue
+        try:
+            out = subprocess.run([path, "-v"], capture_output=True, text=True)
+        except OSError:
+            continue
+        if "Lua 5.4" in (out.stdout + out.stderr):
+            return path
+    return None
+
+
+def lua_sources(data_dir):
+    for root, _, files in os.walk(data_dir):
+        for name in sorted(files):
+            if name.endswith(".lua"):
+                yield os.path.join(root, name)
+
+
+def precompile(data_dir, luac):
+    count = 0
+    failed = 0
+    for src in lua_sources(data_dir):
+        with open(src, "rb") as f:
+            source = f.read()
+
+        fd, tmp = tempfile.mkstemp(suffix=".luac")
+        os.close(fd)
+        try:
+            result = subprocess.run([luac, "-o", tmp, src], capture_output=True, text=True)
+            if result.returncode != 0:
+                print("precompile_lua: %s" % result.stderr.strip())
+                failed += 1
+                continue
+            with open(tmp, "rb") as f:
+                chunk = f.read()
+        finally:
+            os.remove(tmp)
+
+        header = struct.pack("<4sHHII", MAGIC, LUA_VERSION_NUM, 0, len(source), fnv1a(source))
+        with open(src + "c", "wb") as f:
+            f.write(header + chunk)
+        count += 1
+
+    print("precompile_lua: %d chunk(s) written, %d failed" % (count, failed))
+    return failed == 0
+
+
+def clean(data_dir):
+    removed = 0
+    for src in lua_sources(data_dir):
+        if os.path.exists(src + "c"):
+            os.remove(src + "c")
+            removed += 1
+    print("precompile_lua: removed %d chunk(s)" % removed)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Precompile Lua apps into .luac caches")
+    parser.add_argument("data_dir", nargs="?", default="data")
+    parser.add_argument("--luac", default=None)
+    parser.add_argument("--clean", action="store_true")
+    args = parser.parse_args()
+
+    if args.clean:
+        clean(args.data_dir)
+        return 0
+
+    luac = find_luac(args.luac)
+    if not luac:
+        print("precompile_lua: no Lua 5.4 luac found, skipping (device will compile on first launch)")
+        return 0
+
+    return 0 if precompile(args.data_dir, luac) else 1
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO/SCons
+
+    def _before_buildfs(source, target, env):
+        luac = find_luac()
+        if luac:
+            precompile(env.subst("$PROJECT_DATA_DIR"), luac)
+        else:
+            print("precompile_lua: no Lua 5.4 luac found, skipping")
+
+    if not env.get("ESP32_FS_IMAGE_NAME"):  # noqa: F821
+        print("precompile_lua: ESP32_FS_IMAGE_NAME is not set; load this as a post: extra script")
+    else:
+        # buildfs and uploadfs both go through the image, which is always rebuilt
+        env.AddPreAction("$BUILD_DIR/${ESP32_FS_IMAGE_NAME}.bin", _before_buildfs)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        sys.exit(main())
@@ -0,0 +1,172 @@
+
+"""
+Sync data/ to the device over USB serial, sending only files that changed.
+
+Usage:
+    python sync_fs.py PORT [DATA_DIR] [--baud BAUD] [--only PATH ...]
+                      [--delete DEVICE_PATH ...] [--no-precompile]
+
+Options:
+    PORT               Serial port of the device (e.g. /dev/ttyUSB0, COM5)
+    DATA_DIR           Local copy of the filesystem (default: data)
+    --baud BAUD        Serial speed (default: 115200, monitor_speed)
+    --only PATH        Only sync these files or folders under DATA_DIR
+    --delete PATH      Remove a file from the device (path as on the device)
+    --no-precompile    Do not refresh .luac caches with a host luac first
+
+The device must be showing the menu (no app running). For every file the
+script sends its size and FNV-1a hash; the device answers whether its copy
+matches, and only differing files are streamed, in acknowledged chunks,
+into a temporary file that replaces the old one once the hash checks out.
+A changed .lua drops its stale .luac on the device, and the menu is
+rebuilt at the end. See src/serial_sync.cpp for the protocol.
+
+Requires pyserial (pip install pyserial).
+"""
+
+import argparse
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from precompile_lua import fnv1a, find_luac, precompile  # noqa: E402
+
+PROTOCOL_VERSION = 1
+REPLY_TIMEOUT = 5.0
+
+
+class SyncError(Exception):
+    pass
+
+
+class Device:
+    def __init__(self, port, baud):
+        import serial
+
+        # Opening the port may reset the board; give it time to boot
+        self.port = serial.Serial(port, baud, timeout=0.1)
+        self.chunk_size = 0
+
+    def command(self, line):
+        self.port.write((line + "\n").encode("utf-8"))
+        return self.reply()
+
+    def reply(self, timeout=REPLY_TIMEOUT):
+        """Next "@SYNC" line from the device; log output is skipped."""
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            raw = self.port.readline()
+            if not raw:
+                continue
+            line = raw.decode("utf-8", "replace").strip()
+            if line.startswith("@SYNC "):
+                return line[6:]
+        raise SyncError("no reply from device (is the menu showing?)")
+
+    def hello(self, attempts=10):
+        for _ in range(attempts):
+            try:
+                reply = self.command("SYNC HELLO")
+            except SyncError:
+                continue
+            parts = reply.split()
+            if len(parts) == 3 and parts[0] == "OK":
+                if int(parts[1]) != PROTOCOL_VERSION:
+                    raise SyncError("device speaks sync protocol %s, expected %d" % (parts[1], PROTOCOL_VERSION))
+                self.chunk_size = int(parts[2])
+                return
+        raise SyncError("device did not answer SYNC HELLO")
+
+    def changed(self, device_path, data):
+        reply = self.command("SYNC CHECK %d %08x %s" % (len(data), fnv1a(data), device_path))
+        return reply != "SAME"
+
+    def put(self, device_path, data):
+        reply = self.command("SYNC PUT %d %08x %s" % (len(data), fnv1a(data), device_path))
+        if reply != "READY":
+            raise SyncError("%s: %s" % (device_path, reply))
+
+        sent = 0
+        while sent < len(data):
+            chunk = data[sent:sent + self.chunk_size]
+            self.port.write(chunk)
+            sent += len(chunk)
+            reply = self.reply()
+            if reply != "ACK %d" % sent:
+                raise SyncError("%s: %s" % (device_path, reply))
+
+        reply = self.reply()
+        if reply != "DONE":
+            raise SyncError("%s: %s" % (device_path, reply))
+
+    def delete(self, device_path):
+        reply = self.command("SYNC DEL %s" % device_path)
+        if reply != "DONE":
+            raise SyncError("%s: %s" % (device_path, reply))
+
+    def end(self):
+        return self.command("SYNC END")
+
+
+def local_files(data_dir, only):
+    roots = [os.path.join(data_dir, p) for p in only] if only else [data_dir]
+    for root in roots:
+        if os.path.isfile(root):
+            yield root
+            continue
+        for folder, _, files in os.walk(root):
+            for name in sorted(files):
+                if not name.startswith("."):
+                    yield os.path.join(folder, name)
+
+
+def device_path(data_dir, local):
+    return "/" + os.path.relpath(local, data_dir).replace(os.sep, "/")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Sync changed files to the device over serial")
+    parser.add_argument("port")
+    parser.add_argument("data_dir", nargs="?", default="data")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--only", nargs="+", default=[])
+    parser.add_argument("--delete", nargs="+", default=[])
+    parser.add_argument("--no-precompile", action="store_true")
+    args = parser.parse_args()
+
+    if not args.no_precompile:
+        luac = find_luac()
+        if luac:
+            precompile(args.data_dir, luac)
+
+    start = time.time()
+    device = Device(args.port, args.baud)
+    sent = checked = 0
+    try:
+        device.hello()
+        # Sorted so "x.lua" goes before "x.luac": the device drops the
+        # cache of a changed script, then receives the fresh one
+        for local in sorted(local_files(args.data_dir, args.only)):
+            path = device_path(args.data_dir, local)
+            with open(local, "rb") as f:
+                data = f.read()
+            checked += 1
+            if device.changed(path, data):
+                print("sync_fs: %s (%d bytes)" % (path, len(data)))
+                device.put(path, data)
+                sent += len(data)
+        for path in args.delete:
+            print("sync_fs: removing %s" % path)
+            device.delete(path)
+        device.end()
+    except SyncError as e:
+        print("sync_fs: %s" % e)
+        return 1
+
+    print("sync_fs: %d file(s) checked, %d bytes sent in %.1f s" % (checked, sent, time.time() - start))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())